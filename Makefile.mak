@@ -37,9 +37,11 @@ WORKDIR = $(SRCDIR)\.build
 OUTPUT  = $(WORKDIR)\cygwrun.exe
 TESTDA  = $(WORKDIR)\dumpargs.exe
 TESTDE  = $(WORKDIR)\dumpenvp.exe
+ENVHASH = $(WORKDIR)\mkenvhash.exe
+ENVLIST = $(SRCDIR)\cygwenv.lst $(SITE_ENVLIST)
 
 CFLAGS = -DNDEBUG -D_WIN32_WINNT=$(WINVER) -DWINVER=$(WINVER) -DWIN32_LEAN_AND_MEAN
-CFLAGS = $(CFLAGS) -D_CRT_SECURE_NO_WARNINGS  -D_CRT_SECURE_NO_DEPRECATE $(EXTRA_CFLAGS)
+CFLAGS = $(CFLAGS) -D_CRT_SECURE_NO_WARNINGS  -D_CRT_SECURE_NO_DEPRECATE -I$(WORKDIR) $(EXTRA_CFLAGS)
 CLOPTS = -c -nologo $(CRT_CFLAGS) -W4 -O2 -Ob2 -GF -Gs0
 RCOPTS = -nologo -l 0x409 -n
 RFLAGS = -d NDEBUG -d WINVER=$(WINVER) -d _WIN32_WINNT=$(WINVER) -d WIN32_LEAN_AND_MEAN $(EXTRA_RFLAGS)
@@ -56,6 +58,7 @@ RFLAGS = $(RFLAGS) /d _BUILD_NUMBER=$(_BUILD_NUMBER)
 !ENDIF
 
 OBJECTS = \
+	$(WORKDIR)\cygwcore.obj \
 	$(WORKDIR)\cygwrun.obj \
 	$(WORKDIR)\cygwrun.res
 
@@ -77,6 +80,15 @@ $(WORKDIR):
 {$(SRCDIR)\test}.c{$(WORKDIR)}.obj:
 	$(CC) $(CLOPTS) $(CFLAGS) -Fo$(WORKDIR)\ $<
 
+$(ENVHASH): $(WORKDIR) $(WORKDIR)\cygwcore.obj $(SRCDIR)\mkenvhash.c
+	$(CC) $(CLOPTS) $(CFLAGS) -Fo$(WORKDIR)\ $(SRCDIR)\mkenvhash.c
+	$(LN) $(LFLAGS) $(WORKDIR)\mkenvhash.obj $(WORKDIR)\cygwcore.obj $(LDLIBS) -out:$@
+
+$(WORKDIR)\cygwenv.h: $(ENVHASH) $(ENVLIST)
+	$(ENVHASH) $@ $(ENVLIST)
+
+$(WORKDIR)\cygwrun.obj: $(WORKDIR)\cygwenv.h
+
 {$(SRCDIR)}.rc{$(WORKDIR)}.res:
 	$(RC) $(RCOPTS) $(RFLAGS) -fo $@ $<
 
@@ -0,0 +1,4677 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wchar.h>
+#include "cygwcore.h"
+#if CYGWRUN_USE_HEAPAPI || (CYGWRUN_USE_ARENA && defined(_WIN32))
+#include <windows.h>
+#endif
+#if CYGWRUN_USE_SIMD
+#if defined(__AVX2__)
+#include <immintrin.h>
+#else
+#include <emmintrin.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+/**
+ * Slab segment holding converted strings.
+ * String data follows the header.
+ */
+typedef struct xslab_t xslab;
+struct xslab_t {
+    xslab   *next;
+    wchar_t *end;
+};
+#define CYGWRUN_SLAB_HDR        CYGWRUN_ALIGN(sizeof(xslab))
+#define CYGWRUN_SLAB_MAX        ((CYGWRUN_SLAB_SIZE - CYGWRUN_SLAB_HDR) / sizeof(wchar_t) - 16)
+
+#if CYGWRUN_USE_ARENA
+typedef struct xarena_t xarena;
+struct xarena_t {
+    xarena *next;
+    size_t  size;
+    size_t  used;
+};
+#define CYGWRUN_ARENA_HDR       CYGWRUN_ALIGN(sizeof(xarena))
+
+static xarena     *memarena     = NULL;
+#elif CYGWRUN_USE_HEAPAPI
+static HANDLE      memheap      = NULL;
+#if CYGWRUN_USE_MEMFREE && CYGWRUN_ISDEV_VERSION
+static size_t      xzmfree      = 0;
+#endif
+#endif
+
+#if CYGWRUN_ISDEV_VERSION
+size_t             xzalloc      = 0;
+size_t             xzpeak       = 0;
+int                xnalloc      = 0;
+int                xnmfree      = 0;
+int                xnchunk      = 0;
+#endif
+wchar_t           *posixroot    = NULL;
+int                xrmendps     = L'\\';
+wchar_t            zerowcs[8]   = { 0 };
+
+#if CYGWRUN_USE_PATHCACHE
+static xpcentry     xpcache[CYGWRUN_PATHCACHE_SIZE];
+static int          xpcused      = 0;
+static xpcentry     xpdcache[CYGWRUN_DIRCACHE_SIZE];
+static int          xpdused      = 0;
+#endif
+int                 xpchits      = 0;
+int                 xpcmiss      = 0;
+int                 xpdhits      = 0;
+int                 xpdmiss      = 0;
+int                 xlchits      = 0;
+int                 xlcmiss      = 0;
+
+static xmount       xmounts[CYGWRUN_MAX_MOUNTS];
+static int          xnmounts     = 0;
+static xmnode      *xmnodes      = NULL;
+static size_t       xmountrsv    = 3;
+static wchar_t     *xcygdrive    = L"/cygdrive";
+static size_t       xcygdlen     = 9;
+static size_t       xposixrsv    = 11;
+static int          xrmounts[CYGWRUN_MAX_MOUNTS];
+static int          xnrmounts    = 0;
+
+static const wchar_t *rootpaths[]   = {
+    L"/bin/",
+    L"/dev/",
+    L"/etc/",
+    L"/home/",
+    L"/lib/",
+    L"/sbin/",
+    L"/tmp/",
+    L"/usr/",
+    L"/var/",
+    NULL
+};
+
+
+#if CYGWRUN_USE_ARENA
+/**
+ * Allocate new arena chunk
+ *
+ * Chunk memory comes directly from the system,
+ * so it is already zero filled and allocations
+ * do not need to clear the memory.
+ */
+static xarena *xnewchunk(size_t size)
+{
+    xarena *a;
+
+#if defined(_WIN32)
+    a = (xarena *)VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+    a = (xarena *)calloc(1, size);
+#endif
+    if (a == NULL)
+        exit(CYGWRUN_ENOMEM);
+    a->size = size;
+    a->used = CYGWRUN_ARENA_HDR;
+#if CYGWRUN_ISDEV_VERSION
+    xnchunk++;
+    xzpeak += size;
+#endif
+    return a;
+}
+#endif
+
+#if CYGWRUN_USE_ARENA
+static void xfreechunk(xarena *a)
+{
+#if defined(_WIN32)
+    VirtualFree(a, 0, MEM_RELEASE);
+#else
+    free(a);
+#endif
+}
+
+/**
+ * Arena position saved by xmemsave
+ */
+typedef struct xmemmark_t {
+    xarena *a;
+    xarena *n;
+    size_t  used;
+} xmemmark;
+
+static void xmemsave(xmemmark *m)
+{
+    if (memarena == NULL)
+        xmeminit();
+    m->a    = memarena;
+    m->n    = memarena->next;
+    m->used = memarena->used;
+}
+
+/**
+ * Release all memory allocated after xmemsave.
+ *
+ * Chunks created after the mark are freed and the
+ * rest of the marked chunk is cleared, because
+ * allocations expect zero filled memory.
+ */
+static void xmemrestore(const xmemmark *m)
+{
+    xarena *a;
+
+    while (memarena != m->a) {
+        a = memarena;
+        memarena = a->next;
+        xfreechunk(a);
+    }
+    while (memarena->next != m->n) {
+        a = memarena->next;
+        memarena->next = a->next;
+        xfreechunk(a);
+    }
+    memset((char *)memarena + m->used, 0, memarena->used - m->used);
+    memarena->used = m->used;
+}
+#endif
+
+#if CYGWRUN_USE_MEMPROF
+/**
+ * Allocation profiler.
+ *
+ * Allocations are grouped by site, that is the allocation
+ * function and the function that called it. Each allocation
+ * has a header with its site, size and the allocation clock,
+ * so that xmfree can account the lifetime, measured in the
+ * number of allocations made while the memory was in use.
+ */
+#define XMEMPROF_BUCKETS        7
+
+typedef struct xmemsite_t {
+    const char         *wrap;
+    const char         *func;
+    int                 count;
+    int                 freed;
+    unsigned long long  bytes;
+    unsigned long long  life;
+    int                 hist[XMEMPROF_BUCKETS];
+} xmemsite;
+
+typedef struct xmemhdr_t {
+    int                 site;
+    size_t              size;
+    unsigned long long  clock;
+} xmemhdr;
+#define CYGWRUN_MEMPROF_HDR     CYGWRUN_ALIGN(sizeof(xmemhdr))
+
+static xmemsite            xmpsites[CYGWRUN_MEMPROF_SITES];
+static int                 xmpcount     = 0;
+static const char         *xmpwrap      = NULL;
+static const char         *xmpfunc      = NULL;
+static unsigned long long  xmpclock     = 0;
+static unsigned long long  xmplive      = 0;
+static unsigned long long  xmppeak      = 0;
+
+/**
+ * Allocation functions that call other allocation
+ * functions, so that the outer site is kept.
+ */
+static const char *xmpwrappers[] = {
+    "xalloc",
+    "xwalloc",
+    "xmalloc",
+    "xcalloc",
+    "xwaalloc",
+    "xsaalloc",
+    "xmbsslab",
+    "xwcsdup",
+    "xwcsndup",
+    "xstrdup",
+    "xwcsconcat",
+    "xwcsappend",
+    "xstrappend",
+    NULL
+};
+
+void xmemprofsite(const char *wrap, const char *func)
+{
+    const char **w;
+
+    for (w = xmpwrappers; *w; w++) {
+        if (strcmp(*w, func) == 0)
+            return;
+    }
+    xmpwrap = wrap;
+    xmpfunc = func;
+}
+
+static int xmpbucket(size_t n)
+{
+    int    b = 0;
+    size_t z = 16;
+
+    while ((n > z) && (b < XMEMPROF_BUCKETS - 1)) {
+        z <<= 2;
+        b++;
+    }
+    return b;
+}
+
+static int xmpsite(void)
+{
+    int i;
+
+    if (xmpfunc == NULL) {
+        xmpwrap = "xalloc";
+        xmpfunc = "?";
+    }
+    for (i = 0; i < xmpcount; i++) {
+        if (((xmpsites[i].wrap == xmpwrap) || (strcmp(xmpsites[i].wrap, xmpwrap) == 0)) &&
+            ((xmpsites[i].func == xmpfunc) || (strcmp(xmpsites[i].func, xmpfunc) == 0)))
+            return i;
+    }
+    if (i == CYGWRUN_MEMPROF_SITES) {
+        /**
+         * Account the rest to the last site
+         */
+        return i - 1;
+    }
+    xmpsites[i].wrap = xmpwrap;
+    xmpsites[i].func = xmpfunc;
+    xmpcount++;
+    return i;
+}
+
+/**
+ * Fill the header of the new allocation
+ * and return the pointer after the header.
+ */
+static void *xmpalloc(void *p, size_t size)
+{
+    xmemhdr  *h = (xmemhdr *)p;
+    xmemsite *e;
+
+    h->site  = xmpsite();
+    h->size  = size;
+    h->clock = xmpclock++;
+    e = &xmpsites[h->site];
+    e->count++;
+    e->bytes += size;
+    e->hist[xmpbucket(size)]++;
+    xmplive += size;
+    if (xmppeak < xmplive)
+        xmppeak = xmplive;
+    return (char *)p + CYGWRUN_MEMPROF_HDR;
+}
+
+#if CYGWRUN_USE_MEMFREE
+static void *xmpfree(void *m)
+{
+    xmemhdr  *h = (xmemhdr *)((char *)m - CYGWRUN_MEMPROF_HDR);
+    xmemsite *e = &xmpsites[h->site];
+
+    e->freed++;
+    e->life += xmpclock - h->clock;
+    xmplive -= h->size;
+    return h;
+}
+#endif
+
+static int xmpcmp(const void *a1, const void *a2)
+{
+    const xmemsite *s1 = (const xmemsite *)a1;
+    const xmemsite *s2 = (const xmemsite *)a2;
+
+    if (s1->bytes == s2->bytes)
+        return s2->count - s1->count;
+    return s1->bytes < s2->bytes ? 1 : -1;
+}
+
+/**
+ * Print the allocation sites sorted by allocated bytes,
+ * with the histogram of allocation sizes.
+ */
+void xmemprof(FILE *fp)
+{
+    int      i;
+    int      b;
+    char     n[64];
+    xmemsite sa[CYGWRUN_MEMPROF_SITES];
+
+    memcpy(sa, xmpsites, sizeof(xmemsite) * xmpcount);
+    qsort(sa, xmpcount, sizeof(xmemsite), xmpcmp);
+    fprintf(fp, "\n%-36s %7s %10s %7s %7s %8s %6s %6s %6s %6s %6s %6s %6s\n",
+            "site", "allocs", "bytes", "avg", "freed", "lifetime",
+            "<=16", "<=64", "<=256", "<=1K", "<=4K", "<=16K", ">16K");
+    for (i = 0; i < xmpcount; i++) {
+        const xmemsite *e = &sa[i];
+
+        sprintf(n, "%.16s in %.16s", e->wrap, e->func);
+        fprintf(fp, "%-36s %7d %10llu %7llu %7d %8llu",
+                n, e->count, e->bytes, e->bytes / e->count, e->freed,
+                e->freed ? e->life / e->freed : 0ULL);
+        for (b = 0; b < XMEMPROF_BUCKETS; b++)
+            fprintf(fp, " %6d", e->hist[b]);
+        fputc('\n', fp);
+    }
+    fprintf(fp, "Peak heap: %llu bytes, live: %llu bytes, allocations: %llu\n",
+            xmppeak, xmplive, xmpclock);
+}
+#endif
+
+/**
+ * Allocate memory that is not released by xmemrestore.
+ * With arena allocator the memory is taken from its own
+ * chunk, so that it can be released with xkeepfree.
+ */
+static void *xkeepalloc(size_t size)
+{
+#if CYGWRUN_USE_ARENA
+    xarena *a;
+
+    a = xnewchunk(CYGWRUN_ALIGN(size) + CYGWRUN_ARENA_HDR);
+    return (char *)a + CYGWRUN_ARENA_HDR;
+#else
+    return xalloc(size);
+#endif
+}
+
+static void xkeepfree(void *p)
+{
+#if CYGWRUN_USE_ARENA
+    if (p != NULL)
+        xfreechunk((xarena *)((char *)p - CYGWRUN_ARENA_HDR));
+#else
+    xmfree(p);
+#endif
+}
+
+int xmeminit(void)
+{
+#if CYGWRUN_USE_ARENA
+    if (memarena == NULL)
+        memarena = xnewchunk(CYGWRUN_ARENA_CHUNK);
+#elif CYGWRUN_USE_HEAPAPI
+#if CYGWRUN_USE_PRIVATE_HEAP
+    memheap = HeapCreate(0, 0, 0);
+#else
+    memheap = GetProcessHeap();
+#endif
+    if (memheap == NULL)
+        return CYGWRUN_ENOMEM;
+#endif
+    return 0;
+}
+
+void xmemdone(void)
+{
+#if CYGWRUN_USE_MEMPROF
+    xmemprof(stderr);
+#endif
+#if CYGWRUN_USE_MEMSTAT && CYGWRUN_ISDEV_VERSION
+    fprintf(stderr, "\nAllocated: %llu\n"
+                    "Peak     : %llu\n"
+                    "alloc    : %d\n"
+                    "free     : %d\n"
+                    "chunks   : %d\n",
+                    (unsigned long long)xzalloc, (unsigned long long)xzpeak,
+                    xnalloc, xnmfree, xnchunk);
+#endif
+#if CYGWRUN_USE_ARENA
+    while (memarena != NULL) {
+        xarena *a = memarena;
+
+        memarena = a->next;
+        xfreechunk(a);
+    }
+#else
+#if CYGWRUN_USE_MEMFREE && CYGWRUN_ISDEV_VERSION
+    if (xnalloc != xnmfree)
+        fprintf(stderr, "\nAllocated: %llu\n"
+                        "alloc    : %d\n"
+                        "free     : %d\n",
+                        (unsigned long long)xzalloc, xnalloc, xnmfree);
+#endif
+#if CYGWRUN_USE_HEAPAPI
+#if CYGWRUN_USE_MEMFREE && CYGWRUN_ISDEV_VERSION
+    if (xzalloc != xzmfree)
+        fprintf(stderr, "\nAllocated: %llu\n"
+                        "Free     : %llu\n",
+                        (unsigned long long)xzalloc, (unsigned long long)xzmfree);
+#endif
+#if CYGWRUN_USE_PRIVATE_HEAP
+    HeapDestroy(memheap);
+#endif
+#endif
+#endif
+}
+
+void *(xalloc)(size_t size)
+{
+    size_t  s;
+    void   *p;
+#if CYGWRUN_USE_ARENA
+    xarena *a;
+#endif
+
+    /**
+     * Allocations are limited only by the available
+     * memory. The limit prevents size overflow.
+     */
+    if (size > CYGWRUN_MAX_ALLOC)
+        exit(CYGWRUN_ERANGE);
+#if CYGWRUN_USE_MEMPROF
+    s = CYGWRUN_ALIGN(size + CYGWRUN_MEMPROF_HDR);
+#else
+    s = CYGWRUN_ALIGN(size);
+#endif
+#if CYGWRUN_USE_ARENA
+    if (memarena == NULL)
+        xmeminit();
+    a = memarena;
+    if (s > (CYGWRUN_ARENA_CHUNK / 4)) {
+        /**
+         * Large allocations get their own chunk
+         * linked after the current one
+         */
+        a = xnewchunk(s + CYGWRUN_ARENA_HDR);
+        a->next  = memarena->next;
+        memarena->next = a;
+    }
+    else if ((a->size - a->used) < s) {
+        a = xnewchunk(CYGWRUN_ARENA_CHUNK);
+        a->next  = memarena;
+        memarena = a;
+    }
+    p = (char *)a + a->used;
+    a->used += s;
+#elif CYGWRUN_USE_HEAPAPI
+    p = HeapAlloc(memheap, HEAP_ZERO_MEMORY, s);
+#else
+    p = calloc(1, s);
+#endif
+    if (p == NULL)
+        exit(CYGWRUN_ENOMEM);
+#if CYGWRUN_ISDEV_VERSION
+    xzalloc += s;
+    xnalloc++;
+#if !CYGWRUN_USE_ARENA
+    if (xzpeak < xzalloc)
+        xzpeak = xzalloc;
+#endif
+#endif
+#if CYGWRUN_USE_MEMPROF
+    p = xmpalloc(p, size);
+#endif
+    return p;
+}
+
+wchar_t *(xwalloc)(size_t size)
+{
+    if (size > (CYGWRUN_MAX_ALLOC / sizeof(wchar_t)))
+        exit(CYGWRUN_ERANGE);
+    return (wchar_t *)xalloc((size + 2) * sizeof(wchar_t));
+}
+
+char *(xmalloc)(size_t size)
+{
+    return (char *)xalloc(size + 2);
+}
+
+void *(xcalloc)(size_t number, size_t size)
+{
+    if ((size > 0) && (number > (CYGWRUN_MAX_ALLOC / size)))
+        exit(CYGWRUN_ERANGE);
+    return xalloc((number + 2) * size);
+}
+
+wchar_t **(xwaalloc)(size_t size)
+{
+    return (wchar_t **)xcalloc(size, sizeof(wchar_t *));
+}
+
+char **(xsaalloc)(size_t size)
+{
+    return (char **)xcalloc(size, sizeof(char *));
+}
+
+#if CYGWRUN_USE_MEMFREE
+static xslab      *memslabs     = NULL;
+
+/**
+ * Strings inside slab are not separate allocations
+ */
+static int xisslab(const void *m)
+{
+    const xslab *s;
+
+    for (s = memslabs; s != NULL; s = s->next) {
+        if (((const char *)m >= (const char *)s) && ((const wchar_t *)m < s->end))
+            return 1;
+    }
+    return 0;
+}
+
+void xmfree(void *m)
+{
+    if (m != NULL && m != zerowcs && !xisslab(m)) {
+#if CYGWRUN_USE_MEMPROF
+        m = xmpfree(m);
+#endif
+#if CYGWRUN_USE_HEAPAPI
+#if CYGWRUN_ISDEV_VERSION
+        xzmfree += HeapSize(memheap, 0, m);
+#endif
+        HeapFree(memheap, 0, m);
+#else
+        free(m);
+#endif
+#if CYGWRUN_ISDEV_VERSION
+        xnmfree++;
+#endif
+    }
+}
+
+void xafree(void **array)
+{
+    void **ptr = array;
+
+    if (array == NULL)
+        return;
+    while (*ptr != NULL)
+        xmfree(*(ptr++));
+    xmfree(array);
+}
+#endif
+
+/**
+ * Convert n UTF-8 strings into contiguous wide string slab.
+ *
+ * All strings are measured first, and then converted
+ * with a single allocation, unless the total size exceeds
+ * the allocation limit, in which case more segments are used.
+ * Returns NULL terminated array of n pointers into the slab.
+ * Pointers remain valid for the lifetime of the process and
+ * calling xmfree on them is a no-op.
+ */
+wchar_t **(xmbsslab)(const char **sa, int n)
+{
+    int       i;
+    int       x;
+    size_t   *sz;
+    wchar_t **wa;
+
+    wa = xwaalloc(n + 1);
+    sz = (size_t *)xcalloc(n, sizeof(size_t));
+    for (i = 0; i < n; i++)
+        sz[i] = xutf8towcs(NULL, sa[i]) + 1;
+    for (i = 0; i < n; i = x) {
+        size_t   z = sz[i];
+        xslab   *s;
+        wchar_t *d;
+
+        for (x = i + 1; (x < n) && (z + sz[x] < CYGWRUN_SLAB_MAX); x++)
+            z += sz[x];
+        s = (xslab *)xalloc(CYGWRUN_SLAB_HDR + (z + 1) * sizeof(wchar_t));
+        d = (wchar_t *)((char *)s + CYGWRUN_SLAB_HDR);
+        s->end = d + z;
+#if CYGWRUN_USE_MEMFREE
+        s->next  = memslabs;
+        memslabs = s;
+#endif
+        for (; i < x; i++) {
+            wa[i] = d;
+            d += xutf8towcs(d, sa[i]) + 1;
+        }
+    }
+    xmfree(sz);
+    return wa;
+}
+
+/**
+ * Decode single UTF-8 sequence.
+ * Invalid sequences decode to U+FFFD replacement character
+ * like with MultiByteToWideChar.
+ */
+static const char *xutf8next(const char *s, unsigned int *cp)
+{
+    unsigned int c = (unsigned char)s[0];
+    unsigned int m;
+    unsigned int l;
+    int          n;
+    int          i;
+
+    if ((c >= 0xC2) && (c <= 0xDF)) {
+        n = 1;
+        m = c & 0x1F;
+        l = 0x80;
+    }
+    else if ((c >= 0xE0) && (c <= 0xEF)) {
+        n = 2;
+        m = c & 0x0F;
+        l = 0x800;
+    }
+    else if ((c >= 0xF0) && (c <= 0xF4)) {
+        n = 3;
+        m = c & 0x07;
+        l = 0x10000;
+    }
+    else {
+        *cp = 0xFFFD;
+        return s + 1;
+    }
+    for (i = 1; i <= n; i++) {
+        if ((s[i] & 0xC0) != 0x80) {
+            *cp = 0xFFFD;
+            return s + i;
+        }
+        m = (m << 6) | (s[i] & 0x3F);
+    }
+    if ((m < l) || (m > 0x10FFFF) || ((m >= 0xD800) && (m <= 0xDFFF)))
+        m = 0xFFFD;
+    *cp = m;
+    return s + n + 1;
+}
+
+/**
+ * Convert UTF-8 string s to wide string d.
+ * If d is NULL only the length is calculated.
+ * Returns the number of wide characters without terminator.
+ */
+size_t xutf8towcs(wchar_t *d, const char *s)
+{
+    size_t       n = 0;
+    unsigned int c;
+
+    if (s == NULL) {
+        if (d != NULL)
+            *d = 0;
+        return 0;
+    }
+    while (*s) {
+        /**
+         * Fast path for ASCII runs
+         */
+        while ((*s > 0) && ((unsigned char)*s < 0x80)) {
+            if (d != NULL)
+                d[n] = (wchar_t)*s;
+            n++;
+            s++;
+        }
+        if (*s == 0)
+            break;
+        s = xutf8next(s, &c);
+#if WCHAR_MAX <= 0xFFFF
+        if (c > 0xFFFF) {
+            c -= 0x10000;
+            if (d != NULL)
+                d[n] = (wchar_t)(0xD800 | (c >> 10));
+            n++;
+            c  = 0xDC00 | (c & 0x3FF);
+        }
+#endif
+        if (d != NULL)
+            d[n] = (wchar_t)c;
+        n++;
+    }
+    if (d != NULL)
+        d[n] = 0;
+    return n;
+}
+
+/**
+ * Convert wide string s to UTF-8 string d.
+ * If d is NULL only the length is calculated.
+ * Returns the number of bytes without terminator.
+ */
+size_t xwcstoutf8(char *d, const wchar_t *s)
+{
+    size_t       n = 0;
+    unsigned int c;
+
+    if (s == NULL) {
+        if (d != NULL)
+            *d = 0;
+        return 0;
+    }
+    for (; *s; s++) {
+        c = (unsigned int)*s;
+        if (c < 0x80) {
+            if (d != NULL)
+                d[n] = (char)c;
+            n++;
+            continue;
+        }
+        if ((c >= 0xD800) && (c <= 0xDBFF) && (s[1] >= 0xDC00) && (s[1] <= 0xDFFF)) {
+            c = 0x10000 + ((c - 0xD800) << 10) + ((unsigned int)s[1] - 0xDC00);
+            s++;
+        }
+        else if (((c >= 0xD800) && (c <= 0xDFFF)) || (c > 0x10FFFF)) {
+            c = 0xFFFD;
+        }
+        if (d != NULL) {
+            if (c < 0x800) {
+                d[n]     = (char)(0xC0 | (c >> 6));
+                d[n + 1] = (char)(0x80 | (c & 0x3F));
+            }
+            else if (c < 0x10000) {
+                d[n]     = (char)(0xE0 | (c >> 12));
+                d[n + 1] = (char)(0x80 | ((c >> 6) & 0x3F));
+                d[n + 2] = (char)(0x80 | (c & 0x3F));
+            }
+            else {
+                d[n]     = (char)(0xF0 | (c >> 18));
+                d[n + 1] = (char)(0x80 | ((c >> 12) & 0x3F));
+                d[n + 2] = (char)(0x80 | ((c >> 6) & 0x3F));
+                d[n + 3] = (char)(0x80 | (c & 0x3F));
+            }
+        }
+        n += (c < 0x800) ? 2 : ((c < 0x10000) ? 3 : 4);
+    }
+    if (d != NULL)
+        d[n] = 0;
+    return n;
+}
+
+size_t xstrlen(const char *src)
+{
+    const char *s = src;
+
+    if (IS_EMPTY_STR(s))
+        return 0;
+    while (*s)
+        s++;
+    return (size_t)(s - src);
+}
+
+#if CYGWRUN_USE_SIMD
+/**
+ * Vector primitives for the wchar_t size.
+ * Kernels read whole aligned vectors, so they can read
+ * past the terminator, but never cross the page boundary.
+ */
+#if defined(__AVX2__)
+typedef __m256i xvec;
+#define XV_SIZE                 32
+#define XV_LOAD(_p)             _mm256_load_si256((const __m256i *)(_p))
+#define XV_OR(_a, _b)           _mm256_or_si256((_a), (_b))
+#define XV_AND(_a, _b)          _mm256_and_si256((_a), (_b))
+#define XV_MASK(_v)             (unsigned int)_mm256_movemask_epi8(_v)
+#if WCHAR_MAX > 0xFFFF
+#define XV_SET1(_c)             _mm256_set1_epi32((int)(_c))
+#define XV_EQ(_a, _b)           _mm256_cmpeq_epi32((_a), (_b))
+#define XV_GT(_a, _b)           _mm256_cmpgt_epi32((_a), (_b))
+#else
+#define XV_SET1(_c)             _mm256_set1_epi16((short)(_c))
+#define XV_EQ(_a, _b)           _mm256_cmpeq_epi16((_a), (_b))
+#define XV_GT(_a, _b)           _mm256_cmpgt_epi16((_a), (_b))
+#endif
+#else
+typedef __m128i xvec;
+#define XV_SIZE                 16
+#define XV_LOAD(_p)             _mm_load_si128((const __m128i *)(_p))
+#define XV_OR(_a, _b)           _mm_or_si128((_a), (_b))
+#define XV_AND(_a, _b)          _mm_and_si128((_a), (_b))
+#define XV_MASK(_v)             (unsigned int)_mm_movemask_epi8(_v)
+#if WCHAR_MAX > 0xFFFF
+#define XV_SET1(_c)             _mm_set1_epi32((int)(_c))
+#define XV_EQ(_a, _b)           _mm_cmpeq_epi32((_a), (_b))
+#define XV_GT(_a, _b)           _mm_cmpgt_epi32((_a), (_b))
+#else
+#define XV_SET1(_c)             _mm_set1_epi16((short)(_c))
+#define XV_EQ(_a, _b)           _mm_cmpeq_epi16((_a), (_b))
+#define XV_GT(_a, _b)           _mm_cmpgt_epi16((_a), (_b))
+#endif
+#endif
+
+#if defined(__GNUC__)
+#define XV_NOASAN               __attribute__((no_sanitize_address))
+#else
+#define XV_NOASAN
+#endif
+
+static __inline int xvctz(unsigned int m)
+{
+#if defined(_MSC_VER)
+    unsigned long i;
+
+    _BitScanForward(&i, m);
+    return (int)i;
+#else
+    return __builtin_ctz(m);
+#endif
+}
+
+static __inline xvec xvmatch(xvec v, int k, xvec vc)
+{
+    xvec m = XV_EQ(v, XV_SET1(0));
+
+    switch (k) {
+        case XSCAN_CHR:
+            m = XV_OR(m, XV_EQ(v, vc));
+        break;
+        case XSCAN_SEP:
+            m = XV_OR(m, XV_OR(XV_OR(XV_EQ(v, XV_SET1(L'/')),
+                                     XV_EQ(v, XV_SET1(L'\\'))),
+                               XV_OR(XV_EQ(v, XV_SET1(L':')),
+                                     XV_EQ(v, XV_SET1(L';')))));
+        break;
+        case XSCAN_QUOTE:
+            /**
+             * Signed compare is fine for the 0x09 - 0x0D range,
+             * because characters above 0x7FFF are negative.
+             */
+            m = XV_OR(m, XV_OR(XV_OR(XV_EQ(v, XV_SET1(0x20)),
+                                     XV_EQ(v, XV_SET1(0x22))),
+                               XV_AND(XV_GT(v, XV_SET1(0x08)),
+                                      XV_GT(XV_SET1(0x0E), v))));
+        break;
+        case XSCAN_PSWDOT:
+            m = XV_OR(m, XV_OR(XV_OR(XV_EQ(v, XV_SET1(L'/')),
+                                     XV_EQ(v, XV_SET1(L'\\'))),
+                               XV_EQ(v, XV_SET1(L'.'))));
+        break;
+        default:
+        break;
+    }
+    return m;
+}
+
+static XV_NOASAN __inline const wchar_t *xvscan(const wchar_t *s, int k, wchar_t c)
+{
+    const char  *p;
+    unsigned int m;
+    xvec         vc = XV_SET1(c);
+
+    p = (const char *)((size_t)s & ~((size_t)XV_SIZE - 1));
+    m = XV_MASK(xvmatch(XV_LOAD(p), k, vc));
+    m = m & (~0U << ((const char *)s - p));
+    while (m == 0) {
+        p += XV_SIZE;
+        m  = XV_MASK(xvmatch(XV_LOAD(p), k, vc));
+    }
+    return (const wchar_t *)(p + xvctz(m));
+}
+
+#else
+
+static __inline int xscmatch(wchar_t w, int k, wchar_t c)
+{
+    if (w == 0)
+        return 1;
+    switch (k) {
+        case XSCAN_CHR:
+            return (w == c);
+        break;
+        case XSCAN_SEP:
+            return ((w == L'/') || (w == L'\\') || (w == L':') || (w == L';'));
+        break;
+        case XSCAN_QUOTE:
+            return (xisspace(w) || (w == 0x22));
+        break;
+        case XSCAN_PSWDOT:
+            return (IS_PSW(w) || (w == L'.'));
+        break;
+        default:
+        break;
+    }
+    return 0;
+}
+#endif
+
+/**
+ * Return pointer to the first character of class k,
+ * or to the string terminator.
+ */
+wchar_t *xwcsscan(const wchar_t *s, int k, wchar_t c)
+{
+#if CYGWRUN_USE_SIMD
+    /**
+     * Dispatch with constant class, so that each
+     * inlined kernel gets its own specialized loop
+     */
+    switch (k) {
+        case XSCAN_CHR:
+            return (wchar_t *)xvscan(s, XSCAN_CHR, c);
+        break;
+        case XSCAN_SEP:
+            return (wchar_t *)xvscan(s, XSCAN_SEP, c);
+        break;
+        case XSCAN_QUOTE:
+            return (wchar_t *)xvscan(s, XSCAN_QUOTE, c);
+        break;
+        case XSCAN_PSWDOT:
+            return (wchar_t *)xvscan(s, XSCAN_PSWDOT, c);
+        break;
+        default:
+        break;
+    }
+    return (wchar_t *)xvscan(s, XSCAN_NUL, c);
+#else
+    while (!xscmatch(*s, k, c))
+        s++;
+    return (wchar_t *)s;
+#endif
+}
+
+size_t xwcslen(const wchar_t *src)
+{
+    if (IS_EMPTY_WCS(src))
+        return 0;
+    return (size_t)(xwcsscan(src, XSCAN_NUL, 0) - src);
+}
+
+wchar_t *(xwcsdup)(const wchar_t *s)
+{
+    return xwcsndup(s, xwcslen(s));
+}
+
+/**
+ * Duplicate the first n characters of s
+ */
+wchar_t *(xwcsndup)(const wchar_t *s, size_t n)
+{
+    wchar_t *p;
+
+    if (n == 0)
+        return NULL;
+    p = xwalloc(n);
+    return wmemcpy(p, s, n);
+}
+
+char *(xstrdup)(const char *s)
+{
+    char    *p;
+    size_t   n;
+
+    n = xstrlen(s);
+    if (n == 0)
+        return NULL;
+    p = xmalloc(n);
+    return memcpy(p, s, n);
+}
+
+wchar_t *xwcschr(const wchar_t *src, const wchar_t *exc, wchar_t c)
+{
+    const wchar_t *e;
+    const wchar_t *s;
+
+    if (exc) {
+        for (e = exc; *e; e++) {
+            if (*e == c)
+                return NULL;
+        }
+    }
+    s = xwcsscan(src, XSCAN_CHR, c);
+    return *s ? (wchar_t *)s : NULL;
+}
+
+char *xstrchr(const char *src, const char *exc, int c)
+{
+    const char *e;
+    const char *s = src;
+    while (*s) {
+        if (exc) {
+            for (e = exc; *e; e++) {
+                if (*e == c)
+                    return NULL;
+            }
+        }
+        if (*s == c)
+            return (char *)s;
+        s++;
+    }
+    return NULL;
+}
+
+size_t xstrchrn(const char *str, char ch)
+{
+    const char *s = str;
+    while (*s) {
+        if (*s == ch)
+            return (size_t)(s - str);
+        s++;
+    }
+    return 0;
+}
+
+wchar_t *(xwcsconcat)(const wchar_t *s1, const wchar_t *s2, wchar_t qc)
+{
+    wchar_t *rp;
+    wchar_t *rs;
+    size_t   l1;
+    size_t   l2;
+    size_t   sz;
+
+    l1 = xwcslen(s1);
+    l2 = xwcslen(s2);
+
+    sz = l1 + l2;
+    if (sz == 0)
+        return NULL;
+    if (qc)
+       sz += 2;
+    rs = xwalloc(sz);
+    rp = rs;
+    if (qc && !l2)
+        *(rp++) = qc;
+    if (l1 > 0) {
+        wmemcpy(rp, s1, l1);
+        rp += l1;
+    }
+    if (l2 > 0) {
+        if (qc)
+            *(rp++) = qc;
+        wmemcpy(rp, s2, l2);
+        rp += l2;
+    }
+    if (qc) {
+        *(rp++) = qc;
+        *(rp++) = 0;
+    }
+    return rs;
+}
+
+wchar_t *(xwcsappend)(wchar_t *s, const wchar_t *a, wchar_t sc)
+{
+    wchar_t *p;
+    wchar_t *e;
+    size_t   n = xwcslen(s);
+    size_t   z = xwcslen(a);
+
+    p = xwalloc(n + z + 1);
+    e = p;
+
+    if (n > 0) {
+        wmemcpy(e, s, n);
+        e += n;
+    }
+    if (z > 0) {
+        if (n && sc)
+            *(e++) = sc;
+        wmemcpy(e, a, z);
+        e += z;
+    }
+    *e = 0;
+    xmfree(s);
+    return p;
+}
+
+char *(xstrappend)(char *s, const char *a, char sc)
+{
+    char   *p;
+    char   *e;
+    size_t  n = xstrlen(s);
+    size_t  z = xstrlen(a);
+
+    if (z == 0)
+        return s;
+    p = xmalloc(n + z + 1);
+    e = p;
+
+    if (n > 0) {
+        memcpy(e, s, n);
+        e += n;
+    }
+    if (z > 0) {
+        if (n && sc)
+            *(e++) = sc;
+        memcpy(e, a, z);
+        e += z;
+    }
+    *e = 0;
+    xmfree(s);
+    return p;
+}
+
+/**
+ * Remove trailing spaces and return a pointer
+ * to the first non white space character
+ */
+wchar_t *xwcstrim(wchar_t *s)
+{
+    size_t i = xwcslen(s);
+
+    while (i > 0) {
+        i--;
+        if (xisnonchar(s[i]))
+            s[i] = 0;
+        else
+            break;
+    }
+    if (i > 0) {
+        while (xisnonchar(*s))
+            s++;
+    }
+    return s;
+}
+
+char *xstrtrim(char *s)
+{
+    size_t i = xstrlen(s);
+
+    while (i > 0) {
+        i--;
+        if (xisnonchar(s[i]))
+            s[i] = 0;
+        else
+            break;
+    }
+    if (i > 0) {
+        while (xisnonchar(*s))
+            s++;
+    }
+    return s;
+}
+
+char *xstrbegins(int ic, const char *src, const char *str)
+{
+    const char *pos = src;
+    int sa;
+    int sb;
+
+    while (*src) {
+        if (*str == 0)
+            return (char *)pos;
+        if (ic) {
+            sa = xtolower(*src++);
+            sb = xtolower(*str++);
+        }
+        else {
+            sa = *src++;
+            sb = *str++;
+        }
+        if (sa != sb)
+            return NULL;
+        pos++;
+    }
+    return *str ? NULL : (char *)pos;
+}
+
+char *xstrnbegins(int ic, const char *src, const char *str, size_t len)
+{
+    const char *pos = src;
+    int sa;
+    int sb;
+
+    while (*src) {
+        if (*str == 0  || len == 0)
+            return (char *)pos;
+        if (ic) {
+            sa = xtolower(*src++);
+            sb = xtolower(*str++);
+        }
+        else {
+            sa = *src++;
+            sb = *str++;
+        }
+        if (sa != sb)
+            return NULL;
+        pos++;
+        len--;
+    }
+    return len ? NULL : (char *)pos;
+}
+
+int xstrnicmp(const char *s1, const char *s2, size_t n)
+{
+    int sa;
+    int sb;
+
+    if (n == 0)
+        return 0;
+    do {
+        sa = xtoupper(*s1);
+        sb = xtoupper(*s2);
+        if (sa != sb)
+            return (sa - sb);
+        if (sa == 0)
+            break;
+        s1++;
+        s2++;
+    } while (--n != 0);
+    return 0;
+}
+
+int xwcsbegins(const wchar_t *src, const wchar_t *str)
+{
+    while (*src) {
+        if (*str == 0)
+            return 1;
+        if (*src++ != *str++)
+            return 0;
+    }
+    return (*str == 0);
+}
+
+int xwcsequals(const wchar_t *src, const wchar_t *str, wchar_t ech)
+{
+    while (*src) {
+        if (*str == 0)
+            return (*src == 0);
+        if (*src != *str)
+            return 0;
+        src++;
+        str++;
+    }
+    return (*str == ech);
+}
+
+int xwcsnicmp(const wchar_t *s1, const wchar_t *s2, size_t n)
+{
+    int sa;
+    int sb;
+
+    if (n == 0)
+        return 0;
+    do {
+        sa = xtoupper(*s1);
+        sb = xtoupper(*s2);
+        if (sa != sb)
+            return (sa - sb);
+        if (sa == 0)
+            break;
+        s1++;
+        s2++;
+    } while (--n != 0);
+    return 0;
+}
+
+int xwcsicmp(const wchar_t *s1, const wchar_t *s2)
+{
+    int c1;
+    int c2;
+
+    while ((c1 = xtoupper(*s1++)) == (c2 = xtoupper(*s2++))) {
+        if (c1 == 0)
+            return 0;
+    }
+    return (c1 - c2);
+}
+
+int xstricmp(const char *s1, const char *s2)
+{
+    int c1;
+    int c2;
+
+    while ((c1 = xtoupper(*s1++)) == (c2 = xtoupper(*s2++))) {
+        if (c1 == 0)
+            return 0;
+    }
+    return (c1 - c2);
+}
+
+/**
+ * Match string to expression.
+ * Match = 0, NoMatch = 1, Abort = -1
+ * Based loosely on sections of wildmat.c by Rich Salz
+ *
+ * '*' matches any char
+ * '@' character must be alphabetic
+ * '+' character must be not be control or space
+ */
+int xwcsimatch(const wchar_t *wstr, const wchar_t *wexp)
+{
+    for ( ; *wexp != 0; wstr++, wexp++) {
+        if (*wstr == 0 && *wexp != L'*')
+            return -1;
+        switch (*wexp) {
+            case L'*':
+                wexp++;
+                while (*wexp == L'*')
+                    wexp++;
+                if (*wexp == 0)
+                    return 0;
+                while (*wstr != 0) {
+                    int m = xwcsimatch(wstr++, wexp);
+                    if (m != 1)
+                        return m;
+                }
+                return -1;
+            break;
+            case L'@':
+                if (!xisalpha(*wstr))
+                    return -1;
+            break;
+            case L'+':
+                if (xisnonchar(*wstr))
+                    return -1;
+            break;
+            default:
+                if (xtoupper(*wexp) != xtoupper(*wstr))
+                    return 1;
+            break;
+        }
+    }
+    return (*wstr != 0);
+}
+
+int xstrimatch(const char *str, const char *exp)
+{
+    for ( ; *exp; str++, exp++) {
+        if (*str == 0 && *exp != '*')
+            return -1;
+        switch (*exp) {
+            case '*':
+                exp++;
+                while (*exp == '*')
+                    exp++;
+                if (*exp == 0)
+                    return 0;
+                while (*str) {
+                    int m = xstrimatch(str++, exp);
+                    if (m != 1)
+                        return m;
+                }
+                return -1;
+            break;
+            case '@':
+                if (!xisalpha(*str))
+                    return -1;
+            break;
+            case '+':
+                if (xisnonchar(*str))
+                    return -1;
+            break;
+            default:
+                if (xtoupper(*exp) != xtoupper(*str))
+                    return 1;
+            break;
+        }
+    }
+    return (*str != 0);
+}
+
+/**
+ * Get next pattern from the sep delimited list.
+ * Leading and trailing spaces are not part of the pattern.
+ */
+static const wchar_t *xpatnext(const wchar_t **sp, wchar_t sep, size_t *n)
+{
+    const wchar_t *s = *sp;
+    const wchar_t *e;
+
+    while (xisspace(*s) || ((*s == sep) && (sep != 0)))
+        s++;
+    if (*s == 0)
+        return NULL;
+    e = sep ? xwcsscan(s, XSCAN_CHR, sep) : s + xwcslen(s);
+    *sp = e;
+    while ((e > s) && xisspace(e[-1]))
+        e--;
+    *n = (size_t)(e - s);
+    return s;
+}
+
+/**
+ * Add pattern p of length n to the compiled set.
+ * With d set to NULL only the number of positions is returned.
+ */
+static int xpatpos(xpatset *d, const wchar_t *p, size_t n, int x)
+{
+    size_t i;
+    int    c;
+    int    k = 0;
+    int    b = d ? d->npos : 0;
+
+    for (i = 0; i < n; i++) {
+        int w;
+
+        if (p[i] == L'*') {
+            if ((d != NULL) && (k > 0))
+                XPS_SET(d->loop, b + k - 1);
+            continue;
+        }
+        if (d == NULL) {
+            k++;
+            continue;
+        }
+        w = b + k;
+        d->patx[w] = x;
+        if (k == 0) {
+            XPS_SET(d->first, w);
+            if (i > 0)
+                XPS_SET(d->init, w);
+        }
+        if (p[i] == L'@') {
+            for (c = 0x41; c <= 0x5A; c++) {
+                XPS_SET(d->masks + c * d->nwords, w);
+                XPS_SET(d->masks + (c | 0x20) * d->nwords, w);
+            }
+        }
+        else if (p[i] == L'+') {
+            for (c = 0x21; c <= 0x80; c++)
+                XPS_SET(d->masks + c * d->nwords, w);
+        }
+        else if (p[i] < 0x80) {
+            XPS_SET(d->masks + xtoupper(p[i]) * d->nwords, w);
+            XPS_SET(d->masks + xtolower(p[i]) * d->nwords, w);
+        }
+        else {
+            d->hilit[w] = p[i];
+            d->hasuni   = 1;
+        }
+        k++;
+    }
+    if (d != NULL) {
+        if (k == 0) {
+            /**
+             * Pattern matches anything
+             */
+            if (d->anyx < 0)
+                d->anyx = x;
+        }
+        else {
+            XPS_SET(d->last, b + k - 1);
+            d->npos += k;
+        }
+    }
+    return k;
+}
+
+/**
+ * Compile patterns into a single automaton.
+ *
+ * Patterns are taken from NULL terminated array pa followed
+ * by patterns from sep delimited list ps. Either can be NULL.
+ *
+ * Each pattern character except '*' is a state, and all
+ * the states of all patterns are kept in one bit set, so the
+ * name is matched in a single pass whose cost depends only on
+ * the total pattern length, and never backtracks.
+ */
+xpatset *xpatcompile(const wchar_t **pa, const wchar_t *ps, wchar_t sep)
+{
+    int            i;
+    int            x = 0;
+    int            n = 0;
+    size_t         z;
+    const wchar_t *p;
+    const wchar_t *s;
+    xpatset       *d;
+
+    for (i = 0; pa && pa[i]; i++)
+        n += xpatpos(NULL, pa[i], xwcslen(pa[i]), 0);
+    for (s = ps; s && (p = xpatnext(&s, sep, &z)) != NULL; )
+        n += xpatpos(NULL, p, z, 0);
+
+    d = (xpatset *)xcalloc(1, sizeof(xpatset));
+    d->nwords = (n + XPS_BITS) / XPS_BITS;
+    d->anyx   = -1;
+    d->masks  = (unsigned int *)xcalloc(XPS_NMASKS * d->nwords, sizeof(unsigned int));
+    d->first  = (unsigned int *)xcalloc(d->nwords * 5, sizeof(unsigned int));
+    d->init   = d->first + d->nwords;
+    d->loop   = d->init  + d->nwords;
+    d->last   = d->loop  + d->nwords;
+    d->state  = d->last  + d->nwords;
+    d->patx   = (int *)xcalloc(d->nwords * XPS_BITS, sizeof(int));
+    d->hilit  = xwalloc(d->nwords * XPS_BITS);
+
+    for (i = 0; pa && pa[i]; i++)
+        xpatpos(d, pa[i], xwcslen(pa[i]), x++);
+    for (s = ps; s && (p = xpatnext(&s, sep, &z)) != NULL; )
+        xpatpos(d, p, z, x++);
+    d->npats = x;
+    return d;
+}
+
+/**
+ * Match name against compiled pattern set.
+ * Returns the index of first matching pattern or -1.
+ */
+int xpatmatch(const xpatset *ps, const wchar_t *str)
+{
+    int           i;
+    int           w;
+    int           r  = -1;
+    int           nw = ps->nwords;
+    unsigned int *d  = ps->state;
+    const unsigned int *ip = ps->first;
+
+    if (IS_EMPTY_WCS(str) || (ps->npos == 0))
+        return ps->anyx;
+    memset(d, 0, nw * sizeof(unsigned int));
+    for (; *str; str++) {
+        unsigned int   cy = 0;
+        unsigned int   hm;
+        unsigned int   am = 0;
+        int            c  = (int)*str;
+        const unsigned int *bm;
+
+        bm = ps->masks + (c < 0x80 ? c : 0x80) * nw;
+        for (w = 0; w < nw; w++) {
+            unsigned int v = d[w];
+
+            hm = bm[w];
+            if ((c >= 0x80) && ps->hasuni) {
+                for (i = 0; i < XPS_BITS; i++) {
+                    if (ps->hilit[w * XPS_BITS + i] == c)
+                        hm |= 1U << i;
+                }
+            }
+            d[w] = ((((v << 1) | cy) & ~ps->first[w]) | ip[w]) & hm;
+            d[w] |= v & ps->loop[w];
+            cy    = v >> (XPS_BITS - 1);
+            am   |= d[w] | ps->init[w];
+        }
+        ip = ps->init;
+        if (am == 0) {
+            /**
+             * No live state and no pattern can start
+             */
+            return ps->anyx;
+        }
+    }
+    for (w = 0; w < nw; w++) {
+        unsigned int a = d[w] & ps->last[w];
+
+        if (a != 0) {
+            for (i = 0; (a & 1) == 0; i++)
+                a >>= 1;
+            i = ps->patx[w * XPS_BITS + i];
+            if ((r < 0) || (i < r))
+                r = i;
+        }
+    }
+    if ((ps->anyx >= 0) && ((r < 0) || (ps->anyx < r)))
+        r = ps->anyx;
+    return r;
+}
+
+/**
+ * Get the next token delimited by d from the string at c.
+ * The token is trimmed and empty tokens are skipped.
+ * The string is not modified and c is advanced past
+ * the token, so tokens can be taken without allocation.
+ * Returns zero if there are no more tokens.
+ */
+int xwcsnext(const wchar_t **c, wchar_t d, xwcsview *t)
+{
+    const wchar_t *s = *c;
+    const wchar_t *e;
+
+    if (s == NULL)
+        return 0;
+    while (*s != 0) {
+        e = xwcsscan(s, XSCAN_CHR, d);
+        *c = *e ? e + 1 : e;
+        while ((s < e) && xisnonchar(*s))
+            s++;
+        while ((e > s) && xisnonchar(e[-1]))
+            e--;
+        if (e > s) {
+            t->s = s;
+            t->n = (size_t)(e - s);
+            return 1;
+        }
+        s = *c;
+    }
+    return 0;
+}
+
+int xstrntok(const char *s, char d)
+{
+    int n = 1;
+
+    while (*s == d) {
+        s++;
+    }
+    if (*s == 0)
+        return 0;
+    while (*s != 0) {
+        if (*(s++) == d) {
+            while (*s == d) {
+                s++;
+            }
+            if (*s != 0)
+                n++;
+        }
+    }
+    return n;
+}
+
+/**
+ * This is strtok_s clone using single character as token delimiter
+ */
+char *xstrctok(char *s, char d, char **c)
+{
+    char *p;
+
+    if ((s == NULL) && ((s = *c) == NULL))
+        return NULL;
+
+    *c = NULL;
+    /**
+     * Skip leading delimiter
+     */
+    while (*s == d) {
+        s++;
+    }
+    if (*s == 0)
+        return NULL;
+    p = s;
+
+    while (*s != 0) {
+        if (*s == d) {
+            *s = 0;
+            *c = s + 1;
+            break;
+        }
+        s++;
+    }
+    return p;
+}
+
+int xneedsquote(const wchar_t *s)
+{
+    if (IS_EMPTY_WCS(s))
+        return 0;
+    return *xwcsscan(s, XSCAN_QUOTE, 0) != 0;
+}
+
+wchar_t *xwcsquote(wchar_t *s)
+{
+    size_t   n;
+    wchar_t *d;
+    wchar_t *e;
+
+    if (!xneedsquote(s))
+        return s;
+    n = xwcslen(s);
+    e = xwalloc(n + 2);
+    d = e;
+    *(d++) = L'"';
+    wmemcpy(d, s, n);
+    d += n;
+    xmfree(s);
+    *(d++) = L'"';
+    *(d)   = 0;
+
+    return e;
+}
+
+/**
+ * Quote one command line argument if needed. See documentation for
+ * CommandLineToArgV() for details:
+ * https://learn.microsoft.com/en-us/windows/win32/api/shellapi/nf-shellapi-commandlinetoargvw
+ */
+wchar_t *xquotearg(wchar_t *s)
+{
+    size_t   n = 0;
+    wchar_t *c;
+    wchar_t *e;
+    wchar_t *d;
+
+    /* Perform quoting only if necessary. */
+    if (!xneedsquote(s))
+        return s;
+    for (c = s; ; c++) {
+        size_t b = 0;
+
+        while (*c == L'\\') {
+            b++;
+            c++;
+        }
+
+        if (*c == 0) {
+            n += b * 2;
+            break;
+        }
+        else if (*c == L'"') {
+            n += b * 2 + 1;
+            n += 1;
+        }
+        else {
+            n += b;
+            n += 1;
+        }
+    }
+    n += 2;
+    e = xwalloc(n);
+    d = e;
+
+    *(d++) = L'"';
+    for (c = s; ; c++) {
+        size_t b = 0;
+
+        while (*c == '\\') {
+            b++;
+            c++;
+        }
+
+        if (*c == 0) {
+            wmemset(d, L'\\', b * 2);
+            d += b * 2;
+            break;
+        }
+        else if (*c == L'"') {
+            wmemset(d, L'\\', b * 2 + 1);
+            d += b * 2 + 1;
+            *(d++) = *c;
+        }
+        else {
+            wmemset(d, L'\\', b);
+            d += b;
+            *(d++) = *c;
+        }
+    }
+    xmfree(s);
+    *(d++) = L'"';
+    *(d)   = 0;
+
+    return e;
+}
+
+/**
+ * Get the quoted length of the argument.
+ * Program name is only enclosed in quotes if needed, because
+ * CommandLineToArgvW does not process escapes inside argv[0].
+ */
+static size_t xquotedlen(const wchar_t *s, int exe)
+{
+    size_t         n;
+    size_t         b;
+    const wchar_t *q;
+    const wchar_t *p;
+
+    if (IS_EMPTY_WCS(s))
+        return 0;
+    q = xwcsscan(s, XSCAN_QUOTE, 0);
+    n = (size_t)(q - s);
+    if (*q == 0)
+        return n;
+    if (exe)
+        return n + xwcslen(q) + 2;
+    /**
+     * Characters before q are counted once,
+     * and only the backslashes before q matter
+     */
+    for (p = q; (p > s) && (p[-1] == L'\\'); p--)
+        ;
+    b  = (size_t)(q - p);
+    n += 2;
+    for (s = q; *s; s++, n++) {
+        if (*s == L'\\') {
+            b++;
+        }
+        else {
+            if (*s == L'"')
+                n += b + 1;
+            b = 0;
+        }
+    }
+    return n + b;
+}
+
+/**
+ * Copy the quoted argument to d and return the end of the
+ * copied string. Same as xquotearg without allocation.
+ */
+static wchar_t *xquotedcpy(wchar_t *d, const wchar_t *s, int exe)
+{
+    size_t         b = 0;
+    const wchar_t *q;
+
+    if (IS_EMPTY_WCS(s))
+        return d;
+    q = xwcsscan(s, XSCAN_QUOTE, 0);
+    if (*q == 0) {
+        b = (size_t)(q - s);
+        wmemcpy(d, s, b);
+        return d + b;
+    }
+    *(d++) = L'"';
+    for (; *s; s++) {
+        if (exe) {
+            /* Program name is copied as is */
+        }
+        else if (*s == L'\\') {
+            b++;
+        }
+        else {
+            if (*s == L'"') {
+                wmemset(d, L'\\', b + 1);
+                d += b + 1;
+            }
+            b = 0;
+        }
+        *(d++) = *s;
+    }
+    wmemset(d, L'\\', b);
+    d += b;
+    *(d++) = L'"';
+    return d;
+}
+
+/**
+ * Get the length of the command line created by xcmdline,
+ * without the terminating zero.
+ */
+size_t xcmdlinelen(int argc, const wchar_t **argv)
+{
+    int    i;
+    size_t n = 0;
+
+    for (i = 0; i < argc; i++)
+        n += xquotedlen(argv[i], i == 0) + 1;
+    return n > 0 ? n - 1 : 0;
+}
+
+/**
+ * Create the command line from arguments in a single buffer.
+ * Each argument is quoted by CommandLineToArgvW rules and
+ * copied directly to its place. The n is the length
+ * returned by xcmdlinelen.
+ */
+wchar_t *xcmdline(int argc, const wchar_t **argv, size_t n)
+{
+    int      i;
+    wchar_t *bp;
+    wchar_t *ep;
+
+    bp = xwalloc(n);
+    ep = bp;
+    for (i = 0; i < argc; i++) {
+        if (i > 0)
+            *(ep++) = L' ';
+        ep = xquotedcpy(ep, argv[i], i == 0);
+    }
+    *ep = 0;
+    return bp;
+}
+
+int iswinpath(const wchar_t *s)
+{
+    int i = 0;
+
+    if (IS_PSW(s[0])) {
+        if (IS_PSW(s[1]) && (s[2] != 0)) {
+            i  = 2;
+            s += 2;
+            if ((s[0] == L'?' ) &&
+                (IS_PSW(s[1]) ) &&
+                (s[2] != 0)) {
+                /**
+                 * We have \\?\* path
+                 */
+                i += 2;
+                s += 2;
+            }
+        }
+    }
+    if (xisalpha(s[0])) {
+        if (s[1] == L':') {
+            if (s[2] == 0)
+                i += 2;
+            else if (IS_PSW(s[2]))
+                i += 3;
+            else
+                i  = 0;
+        }
+    }
+    return i;
+}
+
+int isdotpath(const wchar_t *s)
+{
+
+    if (s[0] == L'.') {
+        if (IS_PSW(s[1]))
+            return 300;
+        if ((s[1] == L'.') && IS_PSW(s[2]))
+            return 300;
+    }
+    return 0;
+}
+
+/**
+ * Path lexer character classes
+ */
+#define XCC_SLASH       0x01
+#define XCC_BSLASH      0x02
+#define XCC_COLON       0x04
+#define XCC_SEMI        0x08
+#define XCC_DOT         0x10
+#define XCC_ALPHA       0x20
+#define XCC_SPACE       0x40
+#define XCC_LSEP        (XCC_COLON | XCC_SEMI)
+#define XCCLASS(_c)     (((unsigned int)(_c) < 0x80) ? xpathcc[(_c)] : 0)
+#define XLEX_UNKNOWN    -1
+
+static const unsigned char xpathcc[128] = {
+    0x00, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40,
+    0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40,
+    0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40,
+    0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40, 0x40,
+    0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x01,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x04, 0x08, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+    0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+    0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+    0x20, 0x20, 0x20, 0x00, 0x02, 0x00, 0x00, 0x00,
+    0x00, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+    0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+    0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+    0x20, 0x20, 0x20, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+/**
+ * Path list lexer state.
+ * Positions of ':' and ';' characters are stored
+ * in the inline array, and moved to the allocated
+ * one if the string has more separators.
+ * The cls array has the class of each segment
+ * between the separators, and the first segment
+ * class is cls[0].
+ */
+#define CYGWRUN_PLEX_SIZE   32
+
+typedef struct xplex_t {
+    wchar_t  sep;
+    size_t   len;
+    size_t   npos;
+    size_t   zpos;
+    size_t  *pos;
+    int     *cls;
+    size_t   ipos[CYGWRUN_PLEX_SIZE];
+    int      icls[CYGWRUN_PLEX_SIZE + 1];
+} xplex;
+
+static int findmountx(const wchar_t *, size_t *, int, const wchar_t **);
+
+/**
+ * Classify the segment that starts at s and ends at the
+ * next list separator, the same way as isposixpath does
+ * for the zero terminated copy of the segment.
+ * Mount points are found by the trie descent, and the
+ * position where the descent stopped is stored in e,
+ * so that the lexer does not scan those characters again.
+ * Returns XLEX_UNKNOWN for UNC paths, whose class depends
+ * on the characters past the list separator.
+ */
+static int xlexclass(const wchar_t *s, const wchar_t **e)
+{
+    size_t n;
+
+    *e = s;
+    if (*s != L'/')
+        return isdotpath(s);
+    if ((s[1] == 0) || (XCCLASS(s[1]) & XCC_LSEP))
+        return xmnodes ? 301 : 0;
+    if (s[1] == L'/')
+        return XLEX_UNKNOWN;
+    return findmountx(s, &n, 1, e);
+}
+
+/**
+ * Find the list separator of str in a single pass.
+ *
+ * The scanner stops only at path and list separators,
+ * and their class decides the lexer state.
+ * If lx is NULL the scan ends as soon as the separator
+ * is known, otherwise the whole string is scanned and
+ * the string length, separator positions and the class
+ * of each segment are stored inside lx, so that the
+ * elements can be translated without scanning or
+ * classifying the string again.
+ */
+static wchar_t xpathlex(const wchar_t *str, xplex *lx)
+{
+    const wchar_t *s = str;
+    int     k;
+    int     ccolon   = 1;
+    int     pathss   = 0;
+    wchar_t sc       = 0;
+    wchar_t hs       = 0;
+    wchar_t hc       = 0;
+
+    if ((*s == L';') || (*s == L':'))
+        sc = *s;
+    /**
+     * Check if the first elem is windows path
+     */
+    if ((*s == L'\\') || iswinpath(s))
+        ccolon = 0;
+    if (lx != NULL) {
+        const wchar_t *e;
+
+        lx->npos   = 0;
+        lx->zpos   = CYGWRUN_PLEX_SIZE;
+        lx->pos    = lx->ipos;
+        lx->cls    = lx->icls;
+        lx->cls[0] = xlexclass(s, &e);
+        if (e > s)
+            pathss = 1;
+        s = e;
+    }
+    for (;;) {
+        s = xwcsscan(s, XSCAN_SEP, 0);
+        if (*s == 0)
+            break;
+        k = xpathcc[*s];
+        if (k & XCC_SEMI)
+            hs = L';';
+        else if (k & XCC_SLASH)
+            pathss = 1;
+        else if ((k & XCC_COLON) && pathss && ccolon)
+            hc = L':';
+        if (k & XCC_LSEP) {
+            if (lx == NULL) {
+                if (sc || hs)
+                    break;
+            }
+            else {
+                const wchar_t *e;
+
+                if (lx->npos == lx->zpos) {
+                    size_t *p = (size_t *)xalloc(lx->zpos * 2 * sizeof(size_t));
+                    int    *c = (int *)xalloc((lx->zpos * 2 + 1) * sizeof(int));
+
+                    memcpy(p, lx->pos, lx->npos * sizeof(size_t));
+                    memcpy(c, lx->cls, (lx->npos + 1) * sizeof(int));
+                    if (lx->pos != lx->ipos) {
+                        xmfree(lx->pos);
+                        xmfree(lx->cls);
+                    }
+                    lx->pos   = p;
+                    lx->cls   = c;
+                    lx->zpos *= 2;
+                }
+                lx->pos[lx->npos++] = (size_t)(s - str);
+                lx->cls[lx->npos]   = xlexclass(++s, &e);
+                if (e > s)
+                    pathss = 1;
+                s = e;
+                continue;
+            }
+        }
+        s++;
+    }
+    if (sc == 0)
+        sc = hs ? hs : hc;
+    if (lx != NULL) {
+        lx->sep = sc;
+        lx->len = (size_t)(s - str);
+    }
+    return sc;
+}
+
+static void xplexfree(xplex *lx)
+{
+    if (lx->pos != lx->ipos) {
+        xmfree(lx->pos);
+        xmfree(lx->cls);
+    }
+}
+
+int ispathlist(const wchar_t *str)
+{
+    return xpathlex(str, NULL);
+}
+
+/**
+ * Add or replace mount point src mapped to dst.
+ * The src must not have trailing path separator.
+ */
+static int addmount(const wchar_t *src, size_t sn, const wchar_t *dst, size_t dn)
+{
+    int      i;
+    xmount  *m = NULL;
+
+    for (i = 0; i < xnmounts; i++) {
+        if ((xmounts[i].slen == sn) && (wmemcmp(xmounts[i].src, src, sn) == 0)) {
+            m = &xmounts[i];
+            break;
+        }
+    }
+    if (m == NULL) {
+        if (xnmounts >= CYGWRUN_MAX_MOUNTS)
+            return CYGWRUN_ENOSPC;
+        m = &xmounts[xnmounts++];
+        m->src  = xwalloc(sn);
+        m->slen = sn;
+        wmemcpy(m->src, src, sn);
+        m->src[sn] = 0;
+    }
+    m->dst  = xwalloc(dn);
+    wmemcpy(m->dst, dst, dn);
+    m->dst[dn] = 0;
+    m->dst  = wcleanpath(m->dst);
+    m->dlen = xwcslen(m->dst);
+    return 0;
+}
+
+/**
+ * Get next whitespace delimited fstab field.
+ * Octal escapes like \040 are decoded in place.
+ */
+static wchar_t *fstabfield(wchar_t **sp, size_t *n)
+{
+    wchar_t *s = *sp;
+    wchar_t *d;
+    wchar_t *f;
+    wchar_t  c;
+
+    while ((*s == L' ') || (*s == L'\t'))
+        s++;
+    if ((*s == 0) || (*s == L'\n') || (*s == L'\r') || (*s == L'#'))
+        return NULL;
+    f = d = s;
+    while ((*s != 0) && !xisspace(*s)) {
+        if ((s[0] == L'\\') &&
+            (s[1] >= L'0') && (s[1] <= L'3') &&
+            (s[2] >= L'0') && (s[2] <= L'7') &&
+            (s[3] >= L'0') && (s[3] <= L'7')) {
+            *(d++) = (wchar_t)(((s[1] - L'0') << 6) | ((s[2] - L'0') << 3) | (s[3] - L'0'));
+            s += 4;
+        }
+        else {
+            *(d++) = *(s++);
+        }
+    }
+    c   = *s;
+    *d  = 0;
+    *n  = (size_t)(d - f);
+    /**
+     * Keep the line terminator for the caller
+     */
+    *sp = ((c == 0) || (c == L'\n')) ? s : s + 1;
+    if (c == L'\n')
+        *s = c;
+    return f;
+}
+
+/**
+ * Remove trailing and collapse repeated slashes of the
+ * fstab mount point in place, so that the mount point
+ * does not change when the translated path is cleaned.
+ * Returns nonzero if the mount point has "." or ".." segment.
+ */
+static int mountclean(wchar_t *s, size_t *n)
+{
+    size_t i;
+    size_t c = 0;
+
+    for (i = 0; i < *n; i++) {
+        if ((s[i] == L'/') && (c > 0) && (s[c - 1] == L'/'))
+            continue;
+        s[c++] = s[i];
+    }
+    while ((c > 0) && (s[c - 1] == L'/'))
+        c--;
+    for (i = 0; i < c; i++) {
+        if ((s[i] == L'/') && (i + 1 < c) && (s[i + 1] == L'.')) {
+            if ((i + 2 == c) || (s[i + 2] == L'/'))
+                return 1;
+            if ((s[i + 2] == L'.') && ((i + 3 == c) || (s[i + 3] == L'/')))
+                return 1;
+        }
+    }
+    *n = c;
+    return 0;
+}
+
+/**
+ * Insert mount point or cygdrive prefix into the trie
+ */
+static void addmnode(int *nn, const wchar_t *s, size_t n, int x)
+{
+    int    p = 0;
+    int    c;
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+        for (c = xmnodes[p].child; c > 0; c = xmnodes[c].next) {
+            if (xmnodes[c].c == s[i])
+                break;
+        }
+        if (c == 0) {
+            c = (*nn)++;
+            xmnodes[c].c     = s[i];
+            xmnodes[c].mount = -1;
+            xmnodes[c].next  = xmnodes[p].child;
+            xmnodes[p].child = c;
+        }
+        p = c;
+    }
+    if (x < 0)
+        xmnodes[p].cygdrive = 1;
+    else
+        xmnodes[p].mount    = x;
+}
+
+static void xpcclear(void)
+{
+#if CYGWRUN_USE_PATHCACHE
+    memset(xpcache, 0, sizeof(xpcache));
+    memset(xpdcache, 0, sizeof(xpdcache));
+    xpcused  = 0;
+    xpdused  = 0;
+#endif
+}
+
+/**
+ * Initialize mount table.
+ *
+ * Default mount points are the well known posixroot
+ * directories and /cygdrive prefix. Additional mount points
+ * and the cygdrive prefix are taken from the optional
+ * Cygwin fstab formatted text. All mount points are then
+ * compiled into a prefix trie used by isposixpath.
+ */
+int initmounts(const wchar_t *fstab)
+{
+    int      i;
+    int      nn   = 1;
+    size_t   z    = 1;
+    size_t   rn;
+    size_t   sn;
+    wchar_t *cp   = L"/cygdrive";
+    size_t   cn   = 9;
+    wchar_t *ft   = NULL;
+    wchar_t *b;
+
+    xnmounts = 0;
+    /**
+     * Cached translations depend on the mount table
+     */
+    xpcclear();
+    rn = xwcslen(posixroot);
+    for (i = 0; rootpaths[i] != NULL; i++) {
+        wchar_t *d;
+
+        sn = xwcslen(rootpaths[i]) - 1;
+        d  = xwcsconcat(posixroot, rootpaths[i], 0);
+        d[rn + sn] = 0;
+        addmount(rootpaths[i], sn, d, rn + sn);
+        xmfree(d);
+    }
+    if (fstab != NULL)
+        ft = xwcsdup(fstab);
+    for (b = ft; !IS_EMPTY_WCS(b); ) {
+        size_t   dn;
+        size_t   tn;
+        wchar_t *dv;
+        wchar_t *mp;
+        wchar_t *fs;
+
+        dv = fstabfield(&b, &dn);
+        mp = dv ? fstabfield(&b, &sn) : NULL;
+        fs = mp ? fstabfield(&b, &tn) : NULL;
+        if (fs && (mp[0] == L'/') && (mountclean(mp, &sn) == 0)) {
+            if ((tn == 8) && (wmemcmp(fs, L"cygdrive", 8) == 0)) {
+                cp = mp;
+                cn = sn;
+            }
+            else if ((sn > 0) && (dn > 1) && iswinpath(dv)) {
+                int rv = addmount(mp, sn, dv, dn);
+                if (rv)
+                    return rv;
+            }
+        }
+        /**
+         * Skip the rest of the line
+         */
+        b = xwcsscan(b, XSCAN_CHR, L'\n');
+        if (*b)
+            b++;
+    }
+    xmountrsv = rn > 3 ? rn : 3;
+    xposixrsv = cn + 2;
+    for (i = 0; i < xnmounts; i++) {
+        z += xmounts[i].slen;
+        if (xmountrsv < xmounts[i].dlen)
+            xmountrsv = xmounts[i].dlen;
+        if ((xmounts[i].slen > xmounts[i].dlen) &&
+            (xposixrsv < (xmounts[i].slen - xmounts[i].dlen + 2)))
+            xposixrsv = xmounts[i].slen - xmounts[i].dlen + 2;
+    }
+    xcygdrive = xwalloc(cn);
+    xcygdlen  = cn;
+    wmemcpy(xcygdrive, cp, cn);
+    /**
+     * Mount points used by the reverse translation, ordered
+     * by the windows path length, so that the first match is
+     * the longest one. Mount points that map to the same
+     * directory under posixroot are skipped.
+     */
+    xnrmounts = 0;
+    for (i = 0; i < xnmounts; i++) {
+        const xmount *m = &xmounts[i];
+        int j;
+
+        if ((m->dlen == (rn + m->slen)) && (xwcsnicmp(m->dst, posixroot, rn) == 0)) {
+            for (j = 0; j < (int)m->slen; j++) {
+                if (IS_PSW(m->src[j]) ? !IS_PSW(m->dst[rn + j]) :
+                    (xtoupper(m->src[j]) != xtoupper(m->dst[rn + j])))
+                    break;
+            }
+            if (j == (int)m->slen)
+                continue;
+        }
+        for (j = xnrmounts; (j > 0) && (xmounts[xrmounts[j - 1]].dlen < m->dlen); j--)
+            xrmounts[j] = xrmounts[j - 1];
+        xrmounts[j] = i;
+        xnrmounts++;
+    }
+    xmnodes = (xmnode *)xcalloc(z + cn + 1, sizeof(xmnode));
+    xmnodes[0].mount = -1;
+    for (i = 0; i < xnmounts; i++)
+        addmnode(&nn, xmounts[i].src, xmounts[i].slen, i);
+    addmnode(&nn, cp, cn, -1);
+    xmfree(ft);
+    return 0;
+}
+
+/**
+ * Find the longest mount point prefix of posix path
+ * in a single trie descent.
+ *
+ * Returns 100 for cygdrive paths, 101 + x if the path
+ * is below the mount point x, 200 + x if the path is
+ * the mount point itself, and zero if not found.
+ * The length of matched prefix is stored in n.
+ * If ls is nonzero, the path also ends at the list
+ * separator, and the position where the descent
+ * stopped is stored in e.
+ */
+static int findmountx(const wchar_t *s, size_t *n, int ls, const wchar_t **e)
+{
+    int    m = 0;
+    int    p = 0;
+    size_t i;
+
+    if (xmnodes == NULL)
+        return 0;
+    for (i = 0; ; i++) {
+        const xmnode *x = &xmnodes[p];
+        int           z = (s[i] == 0) || (ls && (XCCLASS(s[i]) & XCC_LSEP));
+
+        if ((x->mount >= 0) && ((s[i] == L'/') || z)) {
+            m  = x->mount + (z ? 200 : 101);
+            *n = i;
+        }
+        if (x->cygdrive && (s[i] == L'/') && xisalpha(s[i + 1]) &&
+            (s[i + 2] == L'/') && !xisnonchar(s[i + 3])) {
+            m  = 100;
+            *n = i;
+        }
+        if (z)
+            break;
+        for (p = x->child; p > 0; p = xmnodes[p].next) {
+            if (xmnodes[p].c == s[i])
+                break;
+        }
+        if (p == 0)
+            break;
+    }
+    if (e != NULL)
+        *e = s + i;
+    return m;
+}
+
+static int findmount(const wchar_t *s, size_t *n)
+{
+    return findmountx(s, n, 0, NULL);
+}
+
+int isposixpath(const wchar_t *str)
+{
+    size_t n;
+
+    if (str[0] != L'/')
+        return isdotpath(str);
+    /**
+     * Root is translated to posixroot only after initmounts,
+     * which reserves the space for it inside elemxlat.
+     */
+    if (str[1] == 0)
+        return xmnodes ? 301 : 0;
+    if (str[1] == L'/')
+        return iswinpath(str);
+    return findmount(str, &n);
+}
+
+/**
+ * Classify single path by the class of its first character.
+ */
+static int xpathclass(const wchar_t *s)
+{
+    int k = XCCLASS(*s);
+
+    if (k & XCC_SLASH)
+        return isposixpath(s);
+    if (k & XCC_DOT)
+        return isdotpath(s);
+    return iswinpath(s);
+}
+
+int isanypath(int m, wchar_t *s)
+{
+    int r;
+    if (IS_EMPTY_WCS(s) || (*s == L'\''))
+        return 0;
+    if (m) {
+        r = xpathlex(s, NULL);
+        if (r)
+            return r;
+    }
+    return xpathclass(s);
+}
+
+int xmszcount(const wchar_t *src)
+{
+    int c;
+    const wchar_t *s = src;
+
+    if (IS_EMPTY_WCS(src))
+        return 0;
+    for (c = 0; *s; s++, c++) {
+        while (*s)
+            s++;
+    }
+    return c;
+}
+
+wchar_t *warraytomsz(int cnt, const wchar_t **arr, wchar_t sep)
+{
+    int      i;
+    size_t   n;
+    size_t   len = 0;
+    size_t  *sz;
+    wchar_t *ep;
+    wchar_t *bp;
+
+    sz = (size_t *)xcalloc(cnt, sizeof(size_t));
+    for (i = 0; i < cnt; i++) {
+        n = xwcslen(arr[i]);
+        sz[i] = n++;
+        len  += n;
+    }
+
+    bp = xwalloc(len + 2);
+    ep = bp;
+    for (i = 0; i < cnt; i++) {
+        if (i > 0)
+            *(ep++) = sep;
+        wmemcpy(ep, arr[i], sz[i]);
+        ep += sz[i];
+    }
+    xmfree(sz);
+    ep[0] = 0;
+    ep[1] = 0;
+
+    return bp;
+}
+
+/**
+ * Environment entry with precomputed sort key.
+ * The key holds the first eight upper cased name characters,
+ * so that most comparisons are integer compares.
+ */
+typedef struct xenvkey_t {
+    unsigned long long key[2];
+    const wchar_t     *name;
+    const wchar_t     *val;
+    size_t             nlen;
+    size_t             vlen;
+} xenvkey;
+
+static __inline unsigned long long xenvsortkey(const wchar_t *s, size_t n)
+{
+    unsigned long long k = 0;
+    size_t i;
+
+    for (i = 0; i < 4; i++) {
+        unsigned int c = 0;
+
+        if (i < n) {
+            c = (unsigned int)xtoupper(s[i]);
+            if (c > 0xFFFF)
+                c = 0xFFFF;
+        }
+        k = (k << 16) | c;
+    }
+    return k;
+}
+
+static __inline int xenvkeycmp(const xenvkey *e1, const xenvkey *e2)
+{
+    if (e1->key[0] != e2->key[0])
+        return e1->key[0] < e2->key[0] ? -1 : 1;
+    if (e1->key[1] != e2->key[1])
+        return e1->key[1] < e2->key[1] ? -1 : 1;
+#if WCHAR_MAX <= 0xFFFF
+    if ((e1->nlen >= 8) && (e2->nlen >= 8))
+        return xwcsicmp(e1->name + 8, e2->name + 8);
+#endif
+    return xwcsicmp(e1->name, e2->name);
+}
+
+static int sortenvvars(const void *a1, const void *a2)
+{
+    return xenvkeycmp(*((const xenvkey **)a1), *((const xenvkey **)a2));
+}
+
+/**
+ * Create sorted environment block for CreateProcess.
+ *
+ * Cygwin passes the environment almost sorted, so entries
+ * are sorted by insertion when there are only a few out of
+ * order, and the block is written once at its final size.
+ */
+wchar_t *getenvblock(wchar_t **envvars, wchar_t **envvals)
+{
+    int      i;
+    int      c = 0;
+    int      x = 0;
+    int      u = 0;
+    int      s = 1;
+    size_t   z = 0;
+    wchar_t *bp;
+    wchar_t *eb;
+    xenvkey *ea;
+    xenvkey **pa;
+
+    while (envvars[c])
+        c++;
+    ea = (xenvkey *)xcalloc(c + 1, sizeof(xenvkey));
+    pa = (xenvkey **)xcalloc(c + 1, sizeof(xenvkey *));
+    for (i = 0; i < c; i++) {
+        xenvkey *e = &ea[x];
+
+        e->nlen = xwcslen(envvars[i]);
+        if (e->nlen == 0)
+            continue;
+        u++;
+        e->vlen = xwcslen(envvals[i]);
+        if (e->vlen == 0)
+            continue;
+        e->name = envvars[i];
+        e->val  = envvals[i];
+        e->key[0] = xenvsortkey(e->name, e->nlen);
+        if (e->nlen > 4)
+            e->key[1] = xenvsortkey(e->name + 4, e->nlen - 4);
+        z += e->nlen + e->vlen + 2;
+        if ((x > 0) && (xenvkeycmp(e - 1, e) > 0))
+            s = 0;
+        pa[x++] = e;
+    }
+    if (u == 0) {
+        xmfree(ea);
+        xmfree(pa);
+        return NULL;
+    }
+    if (s == 0) {
+        /**
+         * Insertion sort while the number of moves
+         * stays linear, otherwise use qsort
+         */
+        int m = x * 4;
+
+        for (i = 1; (i < x) && (m > 0); i++) {
+            xenvkey *e = pa[i];
+            int      j = i;
+
+            while ((j > 0) && (xenvkeycmp(pa[j - 1], e) > 0)) {
+                pa[j] = pa[j - 1];
+                j--;
+            }
+            pa[j] = e;
+            m -= i - j;
+        }
+        if (i < x)
+            qsort((void *)pa, x, sizeof(xenvkey *), sortenvvars);
+    }
+    eb = xwalloc(z + 2);
+    bp = eb;
+    for (i = 0; i < x; i++) {
+        const xenvkey *e = pa[i];
+
+        wmemcpy(bp, e->name, e->nlen);
+        bp += e->nlen;
+        *(bp++) = L'=';
+        wmemcpy(bp, e->val, e->vlen);
+        bp += e->vlen;
+        *(bp++) = 0;
+    }
+    bp[0] = 0;
+    bp[1] = 0;
+    xmfree(ea);
+    xmfree(pa);
+    return eb;
+}
+
+/**
+ * If argument starts with '[--]name=' the
+ * function will return the string after '='.
+ */
+wchar_t *cmdoptionval(wchar_t *s)
+{
+    int n = 0;
+
+    if (IS_EMPTY_WCS(s))
+        return NULL;
+    while (*s != 0) {
+        wchar_t c = *(s++);
+        if (n > 0) {
+            if (c == L'=')
+                return s;
+        }
+        if (xisvarchar(c))
+            n++;
+        else
+            break;
+    }
+    return NULL;
+}
+
+wchar_t *wcleanpath(wchar_t *s)
+{
+    int n = 0;
+    int c;
+    int i;
+
+
+    i = (int)xwcslen(s);
+    if (i == 0)
+        return s;
+    if (i > 6) {
+        if (IS_PSW(s[0]) && IS_PSW(s[1]) && (s[2] == L'?') &&
+            IS_PSW(s[3]) && (s[5] == L':')) {
+            s[0] = L'\\';
+            s[1] = L'\\';
+            s[3] = L'\\';
+            s[4] = (wchar_t)xtoupper(s[4]);
+            s[6] = L'\\';
+            n    = 7;
+        }
+    }
+    if ((n == 0) && (i > 2)) {
+        if (xisalpha(s[0]) && (s[1] == L':') && IS_PSW(s[2])) {
+            s[0] = (wchar_t)xtoupper(s[0]);
+            s[2] = L'\\';
+            n    = 3;
+        }
+    }
+    for (c = n; n < i; n++) {
+        if (!IS_PSW(s[n]) && (s[n] != L'.')) {
+            /**
+             * Move the run of ordinary characters at once
+             */
+            int r = (int)(xwcsscan(s + n, XSCAN_PSWDOT, 0) - s);
+
+            if (c != n)
+                wmemmove(s + c, s + n, r - n);
+            c += r - n;
+            n  = r;
+            if (n >= i)
+                break;
+        }
+        if (c > 0) {
+            if (IS_PSW(s[c - 1]) && (s[n] == L'.') && IS_PSW(s[n + 1])) {
+                n++;
+                while (IS_PSW(s[n]))
+                    n++;
+            }
+        }
+        if (IS_PSW(s[n]))  {
+            if (n > 0) {
+                while (IS_PSW(s[n + 1]))
+                    n++;
+            }
+            s[n] = L'\\';
+        }
+        s[c++] = s[n];
+    }
+    s[c--] = 0;
+    while (c > 0) {
+        if ((s[c] == L';') || ((s[c] == xrmendps) && (s[c - 1] != L'.')) || xisnonchar(s[c]))
+            s[c--] = 0;
+        else
+            break;
+    }
+    return s;
+}
+
+wchar_t **wcstoarray(const wchar_t *s, wchar_t sc)
+{
+    int            c = 0;
+    int            x = 0;
+    const wchar_t *cx;
+    xwcsview       t;
+    wchar_t      **sa;
+
+    cx = s;
+    while (xwcsnext(&cx, sc, &t))
+        c++;
+    if (c == 0)
+        return NULL;
+    sa = xwaalloc(c);
+    cx = s;
+    while (xwcsnext(&cx, sc, &t))
+        sa[x++] = xwcsndup(t.s, t.n);
+    sa[x] = NULL;
+    return sa;
+}
+
+char **strtoarray(const char *s, char sc)
+{
+    int      c;
+    int      x = 0;
+    char    *cx = NULL;
+    char    *ws;
+    char    *es;
+    char   **sa;
+
+    if (IS_EMPTY_STR(s))
+        return NULL;
+    c =  xstrntok(s, sc);
+    if (c == 0)
+        return NULL;
+    ws = xstrdup(s);
+    sa = xsaalloc(c);
+    es = xstrctok(ws, sc, &cx);
+    while (es != NULL) {
+        es = xstrtrim(es);
+        if (*es != 0)
+            sa[x++] = xstrdup(es);
+        es = xstrctok(NULL, sc, &cx);
+    }
+    xmfree(ws);
+    sa[x] = NULL;
+    if (x == 0) {
+        xafree(sa);
+        sa = NULL;
+    }
+    return sa;
+}
+
+/**
+ * Translate path element p of length n into d.
+ *
+ * The d must have at least n + xmountrsv + 2 characters
+ * of space. Element is first copied past the reserved area,
+ * translated in place and then moved to d.
+ * Returns the number of characters written or -1 if the
+ * element is not a posix path and sc is ':' list separator.
+ * The mp is the posix path type found by the lexer, or
+ * XLEX_UNKNOWN if the element has to be classified here,
+ * and the posix path type is stored in mp.
+ */
+static int elemxlat(wchar_t *d, const wchar_t *p, size_t n, wchar_t sc, int *mp)
+{
+    int      m = *mp;
+    size_t   x;
+    wchar_t *s;
+
+    s = d + xmountrsv;
+    wmemcpy(s, p, n);
+    s[n] = 0;
+    if (m == XLEX_UNKNOWN)
+        m = isposixpath(s);
+    *mp = m;
+    if (m == 0) {
+        if (sc == L':')
+            return -1;
+        s = wcleanpath(s);
+    }
+    else if (m <  100) {
+        s = wcleanpath(s);
+    }
+    else if (m == 100) {
+        /**
+         * /cygdrive/x/... absolute path
+         */
+        x    = xcygdlen;
+        d[0] = (wchar_t)xtoupper(s[x + 1]);
+        d[1] = L':';
+        d[2] = L'\\';
+        s    = wcleanpath(s + x + 3);
+        n    = xwcslen(s);
+        wmemmove(d + 3, s, n + 1);
+        return (int)(n + 3);
+    }
+    else if (m == 300) {
+        if (ispathlist(s) != L':')
+            s = wcleanpath(s);
+    }
+    else if (m == 301) {
+        x = xwcslen(posixroot);
+        wmemcpy(d, posixroot, x);
+        d[x] = 0;
+        return (int)x;
+    }
+    else {
+        const xmount *mp = &xmounts[m < 200 ? m - 101 : m - 200];
+
+        /**
+         * Mount points are cleaned by initmounts, so cleaning
+         * never changes the length of the mount point prefix,
+         * and it is replaced with its windows path
+         */
+        s = wcleanpath(s);
+        if (*s == L'\\') {
+            n = xwcslen(s + mp->slen);
+            wmemcpy(d, mp->dst, mp->dlen);
+            wmemmove(d + mp->dlen, s + mp->slen, n + 1);
+            return (int)(n + mp->dlen);
+        }
+    }
+    n = xwcslen(s);
+    wmemmove(d, s, n + 1);
+    return (int)n;
+}
+
+#if CYGWRUN_USE_PATHCACHE
+/**
+ * Find entry for key p of length n inside the cache
+ * pc of size z with u entries used.
+ * Returns either the matching or the empty entry
+ * where the key should be stored, or NULL if the
+ * cache is full. Reverse translations use separate
+ * entries selected by rev.
+ */
+static xpcentry *xpclookup(xpcentry *pc, int z, int u,
+                           const wchar_t *p, size_t n, int rev)
+{
+    size_t       i;
+    unsigned int h = rev ? 2166136261U ^ 0x5bd1e995U : 2166136261U;
+    unsigned int x;
+
+    for (i = 0; i < n; i++) {
+        h ^= (unsigned int)p[i];
+        h *= 16777619U;
+    }
+    for (x = h; ; x++) {
+        xpcentry *e = &pc[x & (z - 1)];
+
+        if (e->key == NULL) {
+            if (u >= (z / 4 * 3))
+                return NULL;
+            e->hash = h;
+            e->rev  = rev;
+            return e;
+        }
+        if ((e->hash == h) && (e->klen == n) && (e->rev == rev) &&
+            (wmemcmp(e->key, p, n) == 0))
+            return e;
+    }
+}
+
+static xpcentry *xpcfind(const wchar_t *p, size_t n, int rev)
+{
+    return xpclookup(xpcache, CYGWRUN_PATHCACHE_SIZE, xpcused, p, n, rev);
+}
+
+/**
+ * Find the length of directory part of element p
+ * of length n, if its last component can be appended
+ * to the translated directory without being cleaned.
+ * The name must not have path or list separators, and
+ * must not start or end with space or control character.
+ * Returns zero if the element has no such directory.
+ */
+static size_t xpcdirlen(const wchar_t *p, size_t n)
+{
+    size_t i = n;
+
+    if ((n < 3) || xisnonchar(p[n - 1]) || (p[n - 1] == L'/'))
+        return 0;
+    while (--i > 0) {
+        wchar_t c = p[i];
+
+        if (c == L'/')
+            break;
+        if ((c == L'\\') || (c == L':') || (c == L';'))
+            return 0;
+    }
+    if ((i == 0) || xisnonchar(p[i + 1]))
+        return 0;
+    return i;
+}
+
+/**
+ * Check if any mount point or cygdrive prefix
+ * starts with the first n characters of s.
+ */
+static int xmountbelow(const wchar_t *s, size_t n)
+{
+    int    p = 0;
+    size_t i;
+
+    if (xmnodes == NULL)
+        return 0;
+    for (i = 0; i < n; i++) {
+        for (p = xmnodes[p].child; p > 0; p = xmnodes[p].next) {
+            if (xmnodes[p].c == s[i])
+                break;
+        }
+        if (p == 0)
+            return 0;
+    }
+    return 1;
+}
+#endif
+
+/**
+ * Translate path element p of length n into d.
+ *
+ * Repeated elements are copied from the cache
+ * instead of being translated again.
+ *
+ * Elements below the same directory, like the object
+ * files on a link command line, share the directory
+ * cache entry. Only the directories of elements below
+ * the mount point or cygdrive prefix are cached, and
+ * only if no other mount point is below them, so the
+ * translated directory followed by the name is always
+ * the same as the translated element.
+ * The c is the element class passed to elemxlat.
+ */
+static int elemtowin(wchar_t *d, const wchar_t *p, size_t n, wchar_t sc, int c)
+{
+    int       m = 0;
+    int       r = -1;
+#if CYGWRUN_USE_PATHCACHE
+    size_t    k = 0;
+    xpcentry *e = NULL;
+    xpcentry *x = NULL;
+
+    if (n < CYGWRUN_PATH_MAX)
+        e = xpcfind(p, n, 0);
+    if ((e != NULL) && (e->key != NULL)) {
+        if (e->nopos && (sc == L':')) {
+            xpchits++;
+            return -1;
+        }
+        if (e->val != NULL) {
+            xpchits++;
+            wmemcpy(d, e->val, e->vlen + 1);
+            return (int)e->vlen;
+        }
+    }
+    xpcmiss++;
+    if ((*p == L'/') && (n < CYGWRUN_PATH_MAX))
+        k = xpcdirlen(p, n);
+    if (k > 0) {
+        x = xpclookup(xpdcache, CYGWRUN_DIRCACHE_SIZE, xpdused, p, k, 0);
+        if ((x != NULL) && (x->key != NULL)) {
+            xpdhits++;
+            wmemcpy(d, x->val, x->vlen);
+            d[x->vlen] = L'\\';
+            wmemcpy(d + x->vlen + 1, p + k + 1, n - k - 1);
+            r = (int)(x->vlen + n - k);
+            d[r] = 0;
+            m = 100;
+            x = NULL;
+        }
+        else {
+            xpdmiss++;
+        }
+    }
+#endif
+    if (m == 0) {
+        m = c;
+        r = elemxlat(d, p, n, sc, &m);
+    }
+#if CYGWRUN_USE_PATHCACHE
+    if ((x != NULL) && (m >= 100) && (m < 200) && (r > (int)(n - k)) &&
+        (d[r - (n - k)] == L'\\') &&
+        (wmemcmp(d + r - (n - k) + 1, p + k + 1, n - k - 1) == 0) &&
+        !xmountbelow(p, k + 1)) {
+        x->key  = xwalloc(k);
+        x->klen = k;
+        wmemcpy(x->key, p, k);
+        x->vlen = r - (n - k);
+        x->val  = xwalloc(x->vlen);
+        wmemcpy(x->val, d, x->vlen);
+        xpdused++;
+    }
+    if (e != NULL) {
+        if (e->key == NULL) {
+            e->key  = xwalloc(n);
+            e->klen = n;
+            wmemcpy(e->key, p, n);
+            xpcused++;
+        }
+        e->nopos = (m == 0);
+        if (r >= 0) {
+            e->val  = xwalloc(r);
+            e->vlen = r;
+            wmemcpy(e->val, d, r);
+        }
+    }
+#endif
+    return r;
+}
+
+wchar_t *posixtowin(wchar_t *pp, int m)
+{
+    wchar_t *rp = NULL;
+    size_t   n;
+
+    if (m == 0)
+        m = isposixpath(pp);
+    if (m == 0) {
+        /**
+         * Not a posix path
+         */
+        return pp;
+    }
+    else if (m <  100) {
+        return wcleanpath(pp);
+    }
+    else if (m == 300) {
+        if (ispathlist(pp) == L':')
+            return pp;
+        else
+            return wcleanpath(pp);
+    }
+    else {
+        /**
+         * Mount point, cygdrive or posixroot path
+         */
+        n  = xwcslen(pp);
+        rp = xwalloc(n + xmountrsv + 2);
+        elemtowin(rp, pp, n, 0, m);
+    }
+    xmfree(pp);
+    return rp;
+}
+
+wchar_t *pathtowin(wchar_t *pp)
+{
+    int m;
+
+    m = isanypath(0, pp);
+    if (m)
+        return posixtowin(pp, m);
+    else
+        return pp;
+}
+
+/**
+ * Translate single path or path list found by the lexer.
+ *
+ * Each element is trimmed and translated directly inside
+ * the output buffer, that is sized for the worst case
+ * where every element gets prefixed with posixroot.
+ * If any element of ':' list is not a posix path, the
+ * original value is returned.
+ * The class found by the lexer is used for elements that
+ * are exactly one segment, without surrounding spaces.
+ */
+static wchar_t *lextowin(const wchar_t *ps, const xplex *lx)
+{
+    int      k;
+    int      x;
+    int      nt = 0;
+    size_t   i;
+    size_t   j  = 0;
+    size_t   n;
+    size_t   c  = 0;
+    wchar_t  sc = lx->sep;
+    wchar_t *wp;
+    wchar_t *dp;
+    const wchar_t *s;
+    const wchar_t *e;
+
+    if (sc == 0) {
+        /* Not a path list */
+        wp = xwalloc(lx->len + xmountrsv + 2);
+        elemtowin(wp, ps, lx->len, 0, lx->npos ? XLEX_UNKNOWN : lx->cls[0]);
+        return wp;
+    }
+    for (i = 0; i < lx->npos; i++) {
+        if (ps[lx->pos[i]] == sc)
+            c++;
+    }
+    wp = xwalloc(lx->len + (c + 1) * xmountrsv + 2);
+    dp = wp;
+    s  = ps;
+    for (i = 0; i <= lx->npos; i++) {
+        if (i < lx->npos) {
+            e = ps + lx->pos[i];
+            if (*e != sc)
+                continue;
+        }
+        else {
+            e = ps + lx->len;
+        }
+        if (e > s)
+            nt++;
+        k = (i == j) ? lx->cls[j] : XLEX_UNKNOWN;
+        j = i + 1;
+        if ((s < e) && (XCCLASS(*s) & XCC_SPACE)) {
+            k = XLEX_UNKNOWN;
+            while ((s < e) && (XCCLASS(*s) & XCC_SPACE))
+                s++;
+        }
+        n = (size_t)(e - s);
+        if ((n > 0) && (XCCLASS(s[n - 1]) & XCC_SPACE)) {
+            k = XLEX_UNKNOWN;
+            while ((n > 0) && (XCCLASS(s[n - 1]) & XCC_SPACE))
+                n--;
+        }
+        x = 0;
+        if (n > 0)
+            x = elemtowin(dp > wp ? dp + 1 : dp, s, n, sc, k);
+        if (x < 0) {
+            xmfree(wp);
+            return xwcsdup(ps);
+        }
+        if (x > 0) {
+            if (dp > wp)
+                *(dp++) = L';';
+            dp += x;
+        }
+        s = e + 1;
+    }
+    *dp = 0;
+    if (nt == 0) {
+        xmfree(wp);
+        wp = xwcsdup(ps);
+    }
+    return wp;
+}
+
+wchar_t *pathstowin(const wchar_t *ps)
+{
+    xplex    lx;
+    wchar_t *wp;
+
+    if (IS_EMPTY_WCS(ps))
+        return NULL;
+    xpathlex(ps, &lx);
+    wp = lextowin(ps, &lx);
+    xplexfree(&lx);
+    return wp;
+}
+
+/**
+ * Class of the single path.
+ * Posix and dot paths without list separators were
+ * already classified by the lexer, and only the other
+ * paths have to be classified again.
+ */
+static int xlexpathclass(const wchar_t *ps, const xplex *lx)
+{
+    if ((lx->npos > 0) || (lx->cls[0] == XLEX_UNKNOWN) ||
+        !(XCCLASS(*ps) & (XCC_SLASH | XCC_DOT)))
+        return xpathclass(ps);
+    return lx->cls[0];
+}
+
+wchar_t *anypathtowin(const wchar_t *ps)
+{
+    xplex    lx;
+    wchar_t *wp = NULL;
+
+    if (IS_EMPTY_WCS(ps) || (*ps == L'\''))
+        return NULL;
+    if (xpathlex(ps, &lx) || xlexpathclass(ps, &lx))
+        wp = lextowin(ps, &lx);
+    xplexfree(&lx);
+    return wp;
+}
+
+/**
+ * Remove duplicate and nonexistent directories
+ * from the windows path list.
+ *
+ * Elements are compared case insensitively, ignoring
+ * the trailing backslash, using the hash set of already
+ * seen elements. The isdir is called once for each unique
+ * absolute element, and elements for which it returns
+ * zero are removed. Returns the new path list.
+ */
+wchar_t *prunepath(const wchar_t *ps, int (*isdir)(const wchar_t *))
+{
+    size_t         i;
+    size_t         c = 1;
+    size_t         z = 2;
+    const wchar_t *cx;
+    xwcsview       t;
+    xwcsview      *hs;
+    wchar_t       *wp;
+    wchar_t       *dp;
+    wchar_t       *dn;
+
+    if (IS_EMPTY_WCS(ps))
+        return NULL;
+    for (i = 0; ps[i]; i++) {
+        if (ps[i] == L';')
+            c++;
+    }
+    while (z < c * 2)
+        z <<= 1;
+    hs = (xwcsview *)xcalloc(z, sizeof(xwcsview));
+    wp = xwalloc(i + 1);
+    dp = wp;
+    cx = ps;
+    while (xwcsnext(&cx, L';', &t)) {
+        unsigned int h = 2166136261U;
+
+        if ((t.n > 3) && (t.s[t.n - 1] == L'\\'))
+            t.n--;
+        for (i = 0; i < t.n; i++) {
+            h ^= (unsigned int)xtolower(t.s[i]);
+            h *= 16777619U;
+        }
+        for (h &= z - 1; hs[h].s != NULL; h = (h + 1) & (z - 1)) {
+            if ((hs[h].n == t.n) && (xwcsnicmp(hs[h].s, t.s, t.n) == 0))
+                break;
+        }
+        if (hs[h].s != NULL)
+            continue;
+        hs[h] = t;
+        /**
+         * Copy the element to its place, so that
+         * isdir gets the zero terminated string
+         */
+        dn = dp > wp ? dp + 1 : dp;
+        wmemcpy(dn, t.s, t.n);
+        dn[t.n] = 0;
+        if ((isdir != NULL) && iswinpath(dn) && !isdir(dn))
+            continue;
+        if (dp > wp)
+            *dp = L';';
+        dp = dn + t.n;
+    }
+    *dp = 0;
+    xmfree(hs);
+    return wp;
+}
+
+/**
+ * Translate the command line argument.
+ *
+ * Argument in the form '[--]name=value' gets the value
+ * translated as path list, and any other argument is
+ * translated as single path.
+ */
+wchar_t *argtowin(wchar_t *a)
+{
+    size_t   n;
+    wchar_t  qc = 0;
+    wchar_t *qp = NULL;
+    wchar_t *p;
+    wchar_t *r;
+    wchar_t *v;
+
+    v = cmdoptionval(a);
+    if (v == NULL)
+        return pathtowin(a);
+    if (v[0] == L'"') {
+        /* We have quoted value */
+        n = xwcslen(v) - 1;
+        if ((n > 1) && (v[n] == v[0])) {
+            qc = v[0];
+            qp = v + n;
+            *(qp)  = 0;
+            *(v++) = 0;
+        }
+        else {
+            /**
+             * Found unterminated quote
+             * eg. -a="b
+             * Skip argument
+             */
+            return a;
+        }
+    }
+    p = anypathtowin(v);
+    if (p == NULL) {
+        if (qp != NULL) {
+            *qp = qc;
+            *(--v) = qc;
+        }
+        return a;
+    }
+    if (qp == NULL)
+        v[0] = 0;
+    r = xwcsconcat(a, p, qc);
+    xmfree(a);
+    xmfree(p);
+    return r;
+}
+
+/**
+ * Translate windows path element p of length n into d.
+ *
+ * The path is cleaned and the longest mount point
+ * or posixroot prefix is replaced with its posix path.
+ * Other drive paths get the cygdrive prefix, and UNC
+ * paths only get their separators replaced.
+ * The d must have at least n + xposixrsv + 2 characters.
+ * Returns the length of translated path or -1 if the
+ * element is not windows path.
+ */
+static int elempxlat(wchar_t *d, const wchar_t *p, size_t n)
+{
+    int      i;
+    size_t   k = 0;
+    size_t   x = 0;
+    wchar_t *s;
+
+    s = d + xposixrsv;
+    wmemcpy(s, p, n);
+    s[n] = 0;
+    if (iswinpath(s) == 0)
+        return -1;
+    s = wcleanpath(s);
+    if ((s[0] == L'\\') && (s[1] == L'\\') && (s[2] == L'?') && (s[3] == L'\\')) {
+        if (xisalpha(s[4]) && (s[5] == L':')) {
+            s += 4;
+        }
+        else if (xwcsnicmp(s + 4, L"UNC\\", 4) == 0) {
+            /* \\?\UNC\server\share */
+            s += 6;
+            s[0] = L'\\';
+        }
+    }
+    n = xwcslen(s);
+    if (xisalpha(s[0]) && (s[1] == L':')) {
+        const xmount *mp = NULL;
+
+        x = xwcslen(posixroot);
+        if ((x > n) || ((s[x] != 0) && (s[x] != L'\\')) ||
+            (xwcsnicmp(s, posixroot, x) != 0))
+            x = 0;
+        for (i = 0; i < xnrmounts; i++) {
+            const xmount *m = &xmounts[xrmounts[i]];
+
+            if (m->dlen <= x)
+                break;
+            if ((m->dlen <= n) && ((s[m->dlen] == 0) || (s[m->dlen] == L'\\')) &&
+                (xwcsnicmp(s, m->dst, m->dlen) == 0)) {
+                mp = m;
+                x  = m->dlen;
+                break;
+            }
+        }
+        if (mp != NULL) {
+            k = mp->slen;
+            wmemcpy(d, mp->src, k);
+        }
+        else if (x == 0) {
+            /**
+             * Prefix is written over the drive letter,
+             * so the letter has to be saved first.
+             */
+            wchar_t c = (wchar_t)xtolower(s[0]);
+
+            k = xcygdlen;
+            wmemcpy(d, xcygdrive, k);
+            d[k++] = L'/';
+            d[k++] = c;
+            x = 2;
+        }
+    }
+    wmemmove(d + k, s + x, n - x + 1);
+    n = k + n - x;
+    for (; k < n; k++) {
+        if (d[k] == L'\\')
+            d[k] = L'/';
+    }
+    if (n == 0) {
+        d[n++] = L'/';
+        d[n]   = 0;
+    }
+    return (int)n;
+}
+
+/**
+ * Translate windows path element p of length n into d,
+ * using the same cache as elemtowin.
+ */
+static int elemtoposix(wchar_t *d, const wchar_t *p, size_t n)
+{
+    int       r;
+#if CYGWRUN_USE_PATHCACHE
+    xpcentry *e = NULL;
+
+    if (n < CYGWRUN_PATH_MAX)
+        e = xpcfind(p, n, 1);
+    if ((e != NULL) && (e->key != NULL)) {
+        xpchits++;
+        if (e->nopos)
+            return -1;
+        wmemcpy(d, e->val, e->vlen + 1);
+        return (int)e->vlen;
+    }
+    xpcmiss++;
+#endif
+    r = elempxlat(d, p, n);
+#if CYGWRUN_USE_PATHCACHE
+    if (e != NULL) {
+        e->key  = xwalloc(n);
+        e->klen = n;
+        wmemcpy(e->key, p, n);
+        xpcused++;
+        e->nopos = (r < 0);
+        if (r >= 0) {
+            e->val  = xwalloc(r);
+            e->vlen = r;
+            wmemcpy(e->val, d, r);
+        }
+    }
+#endif
+    return r;
+}
+
+/**
+ * Translate single windows path to posix path.
+ * If pp is not windows path, it is returned unchanged.
+ */
+wchar_t *wintoposix(wchar_t *pp)
+{
+    wchar_t *rp;
+    size_t   n;
+
+    n  = xwcslen(pp);
+    if ((n == 0) || (iswinpath(pp) == 0))
+        return pp;
+    rp = xwalloc(n + xposixrsv + 2);
+    elemtoposix(rp, pp, n);
+    xmfree(pp);
+    return rp;
+}
+
+/**
+ * Translate windows path or ';' path list to posix path
+ * or ':' path list in one pass, like pathstowin.
+ * If any element of the list is not a windows path,
+ * the original value is returned.
+ */
+wchar_t *pathstoposix(const wchar_t *ps)
+{
+    int      x;
+    size_t   n;
+    size_t   c = 0;
+    wchar_t *wp;
+    wchar_t *dp;
+    const wchar_t *s;
+    const wchar_t *e;
+
+    n = xwcslen(ps);
+    if (n == 0)
+        return NULL;
+    if (ispathlist(ps) != L';') {
+        wp = xwalloc(n + xposixrsv + 2);
+        if (elemtoposix(wp, ps, n) < 0)
+            wmemcpy(wp, ps, n + 1);
+        return wp;
+    }
+    for (s = ps; *s; s++) {
+        if (*s == L';')
+            c++;
+    }
+    wp = xwalloc(n + (c + 1) * xposixrsv + 2);
+    dp = wp;
+    for (s = ps; *s; s = e) {
+        e = s;
+        while ((*e != 0) && (*e != L';'))
+            e++;
+        while ((s < e) && xisnonchar(*s))
+            s++;
+        n = (size_t)(e - s);
+        while ((n > 0) && xisnonchar(s[n - 1]))
+            n--;
+        if (*e == L';')
+            e++;
+        if (n == 0)
+            continue;
+        x = elemtoposix(dp > wp ? dp + 1 : dp, s, n);
+        if (x < 0) {
+            xmfree(wp);
+            return xwcsdup(ps);
+        }
+        if (dp > wp)
+            *(dp++) = L':';
+        dp += x;
+    }
+    *dp = 0;
+    if (dp == wp) {
+        xmfree(wp);
+        wp = xwcsdup(ps);
+    }
+    return wp;
+}
+
+/**
+ * Translate the command line argument to posix form.
+ * This is the inverse of argtowin.
+ */
+wchar_t *argtoposix(wchar_t *a)
+{
+    wchar_t *p;
+    wchar_t *r;
+    wchar_t *v;
+
+    v = cmdoptionval(a);
+    if (v == NULL) {
+        r = pathstoposix(a);
+        xmfree(a);
+        return r;
+    }
+    if (IS_EMPTY_WCS(v))
+        return a;
+    p  = pathstoposix(v);
+    *v = 0;
+    r  = xwcsconcat(a, p, 0);
+    xmfree(a);
+    xmfree(p);
+    return r;
+}
+
+static int xstreamwrite(FILE *out, const char *b, size_t n)
+{
+    if ((n > 0) && (fwrite(b, 1, n, out) != n))
+        return CYGWRUN_ENOSPC;
+    return 0;
+}
+
+/**
+ * Translate the stream of records.
+ *
+ * Records are separated by sep, which is either '\n' or zero,
+ * and each record is translated by the xlat function.
+ * Input is read and output is written in CYGWRUN_STREAM_BUFSIZ
+ * chunks. The input buffer is doubled for records that do
+ * not fit, and is kept outside the arena, so that it survives
+ * the memory release. The separator is written only if the
+ * input record was terminated.
+ *
+ * Memory used by translations is released after every
+ * CYGWRUN_STREAM_RESET input bytes, together with the path
+ * cache entries that were allocated from that memory.
+ */
+static int xstream(FILE *in, FILE *out, int sep, wchar_t *(*xlat)(wchar_t *))
+{
+    char    *ib;
+    char    *ob;
+    size_t   ni = 0;
+    size_t   no = 0;
+    size_t   nb = 0;
+    size_t   iz = CYGWRUN_STREAM_BUFSIZ;
+    int      rv = 0;
+    int      eof;
+#if CYGWRUN_USE_ARENA
+    xmemmark mm;
+#endif
+
+    ib = (char *)xkeepalloc(iz + 2);
+    ob = xmalloc(CYGWRUN_STREAM_BUFSIZ);
+#if CYGWRUN_USE_ARENA
+    xmemsave(&mm);
+#endif
+    do {
+        char  *s = ib;
+        size_t n;
+
+        n   = fread(ib + ni, 1, iz - ni, in);
+        eof = (n == 0);
+        if (eof && ferror(in)) {
+            rv = CYGWRUN_EBADPATH;
+            break;
+        }
+        ni += n;
+        while (ni > 0) {
+            char    *e;
+            wchar_t *w;
+            size_t   z;
+            int      t = 1;
+
+            e = memchr(s, sep, ni);
+            if (e == NULL) {
+                if (!eof) {
+                    if (ni == iz) {
+                        /* Record does not fit in the buffer */
+                        s = (char *)xkeepalloc(iz * 2 + 2);
+                        memcpy(s, ib, ni);
+                        xkeepfree(ib);
+                        ib  = s;
+                        iz *= 2;
+                    }
+                    break;
+                }
+                e = s + ni;
+                t = 0;
+            }
+            z   = (size_t)(e - s);
+            ni -= z + t;
+            nb += z + t;
+            *e  = '\0';
+            if ((sep == '\n') && (z > 0) && (s[z - 1] == '\r'))
+                s[z - 1] = '\0';
+            w = xwalloc(z);
+            xutf8towcs(w, s);
+            w = xlat(w);
+            s = e + t;
+            z = xwcstoutf8(NULL, w);
+            if ((no + z + 2) > CYGWRUN_STREAM_BUFSIZ) {
+                rv = xstreamwrite(out, ob, no);
+                no = 0;
+                if (rv)
+                    break;
+            }
+            if ((z + 2) > CYGWRUN_STREAM_BUFSIZ) {
+                char *u = xmalloc(z);
+
+                xwcstoutf8(u, w);
+                rv = xstreamwrite(out, u, z);
+                xmfree(u);
+                if (rv)
+                    break;
+            }
+            else {
+                no += xwcstoutf8(ob + no, w);
+            }
+            if (t)
+                ob[no++] = (char)sep;
+            xmfree(w);
+        }
+        if (rv)
+            break;
+        if (ni > 0)
+            memmove(ib, s, ni);
+#if CYGWRUN_USE_ARENA
+        if (nb > CYGWRUN_STREAM_RESET) {
+            xpcclear();
+            xmemrestore(&mm);
+            nb = 0;
+        }
+#endif
+    } while (!eof);
+    if (rv == 0)
+        rv = xstreamwrite(out, ob, no);
+    if ((rv == 0) && (fflush(out) != 0))
+        rv = CYGWRUN_ENOSPC;
+    xmfree(ob);
+    xkeepfree(ib);
+    return rv;
+}
+
+int xstreamtowin(FILE *in, FILE *out, int sep)
+{
+    return xstream(in, out, sep, argtowin);
+}
+
+int xstreamtoposix(FILE *in, FILE *out, int sep)
+{
+    return xstream(in, out, sep, argtoposix);
+}
+
+/**
+ * Response file output buffer
+ */
+typedef struct xrspout_t {
+    FILE   *f;
+    char   *b;
+    size_t  n;
+    int     wide;                       /** Write UTF-16LE              */
+} xrspout;
+
+static int xrspflush(xrspout *o)
+{
+    int rv = xstreamwrite(o->f, o->b, o->n);
+
+    o->n = 0;
+    return rv;
+}
+
+/**
+ * Write wide string as UTF-16LE or UTF-8
+ */
+static int xrspwrite(xrspout *o, const wchar_t *s)
+{
+    int    rv = 0;
+    size_t z;
+
+    if (o->wide) {
+        for (; *s; s++) {
+            unsigned int c = (unsigned int)*s;
+
+            if ((o->n + 4) > CYGWRUN_STREAM_BUFSIZ) {
+                rv = xrspflush(o);
+                if (rv)
+                    return rv;
+            }
+            if (c > 0xFFFF) {
+                c -= 0x10000;
+                o->b[o->n++] = (char)((c >> 10) & 0xFF);
+                o->b[o->n++] = (char)(0xD8 | (c >> 18));
+                c = 0xDC00 | (c & 0x3FF);
+            }
+            o->b[o->n++] = (char)(c & 0xFF);
+            o->b[o->n++] = (char)(c >> 8);
+        }
+        return 0;
+    }
+    z = xwcstoutf8(NULL, s);
+    if ((o->n + z + 2) > CYGWRUN_STREAM_BUFSIZ) {
+        rv = xrspflush(o);
+        if (rv)
+            return rv;
+    }
+    if ((z + 2) > CYGWRUN_STREAM_BUFSIZ) {
+        char *u = xmalloc(z);
+
+        xwcstoutf8(u, s);
+        rv = xstreamwrite(o->f, u, z);
+        xmfree(u);
+    }
+    else {
+        o->n += xwcstoutf8(o->b + o->n, s);
+    }
+    return rv;
+}
+
+/**
+ * Decode the chunk of UTF-8 or UTF-16LE bytes into d.
+ * Incomplete sequence at the end of b is not decoded,
+ * and the number of decoded bytes is stored in u.
+ * Returns the number of decoded characters.
+ */
+static size_t xrspdecode(wchar_t *d, char *b, size_t n, int wide, int eof, size_t *u)
+{
+    size_t x = n;
+    size_t r;
+    char   c;
+
+    if (wide) {
+        x &= ~(size_t)1;
+        for (r = 0; (r * 2) < x; r++) {
+            d[r] = (wchar_t)((unsigned char)b[r * 2] |
+                             ((unsigned char)b[r * 2 + 1] << 8));
+        }
+        *u = x;
+        return r;
+    }
+    if (!eof) {
+        /**
+         * Find the start of the last sequence
+         */
+        while ((x > 0) && (n - x < 4) && (((unsigned char)b[x - 1] & 0xC0) == 0x80))
+            x--;
+        if ((x > 0) && ((unsigned char)b[x - 1] >= 0xC0))
+            x--;
+        else
+            x = n;
+    }
+    c    = b[x];
+    b[x] = '\0';
+    r    = xutf8towcs(d, b);
+    b[x] = c;
+    *u   = x;
+    return r;
+}
+
+/**
+ * Translate the response file.
+ *
+ * Arguments are split by CommandLineToArgvW rules, each one
+ * is translated like the command line argument and written
+ * quoted on a separate line. Output has the same encoding
+ * as the input, that is either UTF-16LE with BOM or UTF-8.
+ * The file is processed in CYGWRUN_RSPBUF_SIZE chunks, and
+ * the argument buffer is doubled for longer arguments.
+ */
+int xrsptowin(FILE *in, FILE *out)
+{
+    char    *ib;
+    wchar_t *wb;
+    wchar_t *ab;
+    size_t   ni  = 0;
+    size_t   na  = 0;
+    size_t   nb  = 0;
+    size_t   bs  = 0;
+    size_t   az  = CYGWRUN_RSPARG_MAX;
+    int      inq = 0;
+    int      dq  = 0;
+    int      arg = 0;
+    int      bom = 1;
+    int      rv  = 0;
+    int      eof;
+    xrspout  o;
+#if CYGWRUN_USE_ARENA
+    xmemmark mm;
+#endif
+
+    ib     = xmalloc(CYGWRUN_RSPBUF_SIZE);
+    wb     = xwalloc(CYGWRUN_RSPBUF_SIZE);
+    ab     = (wchar_t *)xkeepalloc(az * sizeof(wchar_t));
+    o.f    = out;
+    o.b    = xmalloc(CYGWRUN_STREAM_BUFSIZ);
+    o.n    = 0;
+    o.wide = 0;
+#if CYGWRUN_USE_ARENA
+    xmemsave(&mm);
+#endif
+    do {
+        size_t i;
+        size_t n;
+        size_t u;
+
+        n   = fread(ib + ni, 1, CYGWRUN_RSPBUF_SIZE - ni, in);
+        eof = (n == 0);
+        if (eof && ferror(in)) {
+            rv = CYGWRUN_EBADPATH;
+            break;
+        }
+        ni += n;
+        if (bom) {
+            const unsigned char *p = (const unsigned char *)ib;
+
+            if ((ni < 3) && !eof)
+                continue;
+            bom = 0;
+            if ((ni >= 2) && (p[0] == 0xFF) && (p[1] == 0xFE)) {
+                o.wide = 1;
+                o.n    = 2;
+            }
+            else if ((ni >= 3) && (p[0] == 0xEF) && (p[1] == 0xBB) && (p[2] == 0xBF)) {
+                o.n    = 3;
+            }
+            /* Keep the BOM */
+            memcpy(o.b, ib, o.n);
+            ni -= o.n;
+            memmove(ib, ib + o.n, ni);
+        }
+        n = xrspdecode(wb, ib, ni, o.wide, eof, &u);
+        ni -= u;
+        nb += u;
+        if (ni > 0)
+            memmove(ib, ib + u, ni);
+        for (i = 0; i <= n; i++) {
+            wchar_t c;
+
+            if (i == n) {
+                if (!eof)
+                    break;
+                /* Terminate the last argument */
+                c   = L'\n';
+                inq = 0;
+                dq  = 0;
+            }
+            else {
+                c = wb[i];
+            }
+            if (dq) {
+                dq = 0;
+                if ((c == L'"') && (bs == 0)) {
+                    /* Double quote inside quotes */
+                    ab[na++] = c;
+                    inq = 1;
+                    continue;
+                }
+            }
+            if (c == L'\\') {
+                bs++;
+                continue;
+            }
+            if ((na + bs + 2) >= az) {
+                wchar_t *b;
+
+                /* Argument does not fit in the buffer */
+                while ((na + bs + 2) >= az)
+                    az *= 2;
+                b = (wchar_t *)xkeepalloc(az * sizeof(wchar_t));
+                wmemcpy(b, ab, na);
+                xkeepfree(ab);
+                ab = b;
+            }
+            if (c == L'"') {
+                wmemset(ab + na, L'\\', bs / 2);
+                na += bs / 2;
+                arg = 1;
+                if (bs & 1) {
+                    ab[na++] = c;
+                }
+                else {
+                    dq  = inq;
+                    inq = !inq;
+                }
+                bs = 0;
+                continue;
+            }
+            wmemset(ab + na, L'\\', bs);
+            na += bs;
+            bs  = 0;
+            if (!inq && ((c == L' ') || (c == L'\t') || (c == L'\r') || (c == L'\n'))) {
+                if (na > 0) {
+                    wchar_t *a;
+
+                    ab[na] = 0;
+                    a  = xquotearg(argtowin(xwcsdup(ab)));
+                    rv = xrspwrite(&o, a);
+                    xmfree(a);
+                }
+                else if (arg) {
+                    rv = xrspwrite(&o, L"\"\"");
+                }
+                if ((rv == 0) && ((na > 0) || arg))
+                    rv = xrspwrite(&o, L"\n");
+                if (rv)
+                    break;
+                na  = 0;
+                arg = 0;
+                continue;
+            }
+            ab[na++] = c;
+            arg = 1;
+        }
+        if (rv)
+            break;
+#if CYGWRUN_USE_ARENA
+        if (nb > CYGWRUN_STREAM_RESET) {
+            xpcclear();
+            xmemrestore(&mm);
+            nb = 0;
+        }
+#endif
+    } while (!eof);
+    if (rv == 0)
+        rv = xrspflush(&o);
+    if ((rv == 0) && (fflush(out) != 0))
+        rv = CYGWRUN_ENOSPC;
+    xmfree(o.b);
+    xkeepfree(ab);
+    xmfree(wb);
+    xmfree(ib);
+    return rv;
+}
+
+/**
+ * Write the arguments to the response file quoted,
+ * one argument per line, either as UTF-16LE with BOM or UTF-8.
+ * Output is buffered, so the file is written in as few
+ * writes as possible.
+ */
+int xargstorsp(FILE *out, int argc, const wchar_t **argv, int wide)
+{
+    int     i;
+    int     rv = 0;
+    xrspout o;
+
+    o.f    = out;
+    o.b    = xmalloc(CYGWRUN_STREAM_BUFSIZ);
+    o.n    = 0;
+    o.wide = wide;
+    if (wide) {
+        o.b[o.n++] = (char)0xFF;
+        o.b[o.n++] = (char)0xFE;
+    }
+    for (i = 0; (rv == 0) && (i < argc); i++) {
+        wchar_t *q = xwalloc(xquotedlen(argv[i], 0));
+
+        *xquotedcpy(q, argv[i], 0) = 0;
+        rv = xrspwrite(&o, q);
+        if (rv == 0)
+            rv = xrspwrite(&o, L"\n");
+        xmfree(q);
+    }
+    if (rv == 0)
+        rv = xrspflush(&o);
+    if ((rv == 0) && (fflush(out) != 0))
+        rv = CYGWRUN_ENOSPC;
+    xmfree(o.b);
+    return rv;
+}
+
+/**
+ * Persistent launch cache.
+ *
+ * Each entry maps the key to the value, and it is valid
+ * while the file vfile has the same modification time as
+ * when the entry was created. File access goes through xfs,
+ * so the cache can be tested without real file system.
+ *
+ * The cache file is UTF-8 text with one entry per line:
+ * mtime TAB vfile TAB value TAB key
+ */
+static const xfsops *xfs         = NULL;
+static wchar_t     *xlcfile      = NULL;
+static xlcentry     xlcents[CYGWRUN_LCACHE_MAX];
+static int          xlcount      = 0;
+static int          xlcdirty     = 0;
+
+static int xlcvalid(const wchar_t *s)
+{
+    return !IS_EMPTY_WCS(s) && (*xwcsscan(s, XSCAN_CHR, L'\t') == 0) &&
+           (*xwcsscan(s, XSCAN_CHR, L'\n') == 0);
+}
+
+static xlcentry *xlcfind(const wchar_t *key)
+{
+    int i;
+
+    for (i = 0; i < xlcount; i++) {
+        if (wcscmp(xlcents[i].key, key) == 0)
+            return &xlcents[i];
+    }
+    return NULL;
+}
+
+/**
+ * Add entry, dropping the oldest one if the cache is full
+ */
+static void xlcadd(const wchar_t *key, const wchar_t *val,
+                   const wchar_t *vfile, unsigned long long mtime)
+{
+    xlcentry *e = xlcfind(key);
+
+    if (e == NULL) {
+        if (xlcount == CYGWRUN_LCACHE_MAX) {
+            memmove(xlcents, xlcents + 1, sizeof(xlcentry) * (CYGWRUN_LCACHE_MAX - 1));
+            xlcount--;
+        }
+        e = &xlcents[xlcount++];
+        e->key = xwcsdup(key);
+    }
+    e->val   = xwcsdup(val);
+    e->vfile = xwcsdup(vfile);
+    e->mtime = mtime;
+}
+
+/**
+ * Load launch cache from file
+ */
+int xlcinit(const xfsops *fs, const wchar_t *file)
+{
+    wchar_t *b;
+    wchar_t *s;
+
+    xfs      = fs;
+    xlcount  = 0;
+    xlcdirty = 0;
+    xlcfile  = xwcsdup(file);
+    if ((xfs == NULL) || (xlcfile == NULL))
+        return CYGWRUN_EINVAL;
+    b = xfs->readfile(xlcfile);
+    for (s = b; !IS_EMPTY_WCS(s); ) {
+        wchar_t *f[4];
+        wchar_t *e;
+        int      i;
+        unsigned long long mt = 0;
+
+        e = xwcsscan(s, XSCAN_CHR, L'\n');
+        if (*e)
+            *(e++) = 0;
+        for (i = 0; i < 4; i++) {
+            f[i] = s;
+            s    = xwcsscan(s, XSCAN_CHR, L'\t');
+            if ((*s == 0) && (i < 3))
+                break;
+            if (i < 3)
+                *(s++) = 0;
+        }
+        if ((i == 4) && !IS_EMPTY_WCS(f[1]) && !IS_EMPTY_WCS(f[2]) && !IS_EMPTY_WCS(f[3])) {
+            wchar_t *h;
+
+            for (h = f[0]; *h; h++) {
+                int c = xtolower(*h);
+
+                if ((c >= L'0') && (c <= L'9'))
+                    mt = (mt << 4) | (unsigned long long)(c - L'0');
+                else if ((c >= L'a') && (c <= L'f'))
+                    mt = (mt << 4) | (unsigned long long)(c - L'a' + 10);
+                else
+                    break;
+            }
+            if ((*h == 0) && (h > f[0]))
+                xlcadd(f[3], f[2], f[1], mt);
+        }
+        s = e;
+    }
+    xmfree(b);
+    return 0;
+}
+
+/**
+ * Get the modification time of vfile.
+ * The vfile can be ';' separated list of files, where the
+ * first file must exist, and the times of all files are
+ * combined into one value. Missing files, except the first
+ * one, are included as zero time.
+ */
+static int xlcmtime(const wchar_t *vfile, unsigned long long *mt)
+{
+    int                i;
+    unsigned long long h;
+    unsigned long long t;
+    const wchar_t     *s;
+    const wchar_t     *e;
+    wchar_t           *f;
+
+    e = xwcsscan(vfile, XSCAN_CHR, L';');
+    if (*e == 0)
+        return xfs->mtime(vfile, mt);
+    f = xwcsndup(vfile, (size_t)(e - vfile));
+    i = xfs->mtime(f, &h);
+    xmfree(f);
+    if (i != 0)
+        return i;
+    for (s = e; *s; s = e) {
+        s++;
+        e = xwcsscan(s, XSCAN_CHR, L';');
+        f = xwcsndup(s, (size_t)(e - s));
+        if ((f == NULL) || (xfs->mtime(f, &t) != 0))
+            t = 0;
+        xmfree(f);
+        h = (h ^ t) * 1099511628211ULL;
+    }
+    *mt = h;
+    return 0;
+}
+
+/**
+ * Get cached value.
+ * Returns NULL if not found or if the entry is stale.
+ */
+wchar_t *xlcget(const wchar_t *key)
+{
+    xlcentry          *e;
+    unsigned long long mt;
+
+    if ((xfs == NULL) || (key == NULL))
+        return NULL;
+    e = xlcfind(key);
+    if (e == NULL) {
+        xlcmiss++;
+        return NULL;
+    }
+    if ((xlcmtime(e->vfile, &mt) != 0) || (mt != e->mtime)) {
+        /**
+         * Drop stale entry
+         */
+        xlcount--;
+        memmove(e, e + 1, sizeof(xlcentry) * (size_t)(xlcents + xlcount - e));
+        xlcdirty = 1;
+        xlcmiss++;
+        return NULL;
+    }
+    xlchits++;
+    return xwcsdup(e->val);
+}
+
+/**
+ * Store value that remains valid while vfile is unchanged.
+ * The vfile can be ';' separated list of files.
+ */
+void xlcput(const wchar_t *key, const wchar_t *val, const wchar_t *vfile)
+{
+    unsigned long long mt;
+
+    if ((xfs == NULL) || !xlcvalid(key) || !xlcvalid(val) || !xlcvalid(vfile))
+        return;
+    if (xlcmtime(vfile, &mt) != 0)
+        return;
+    xlcadd(key, val, vfile, mt);
+    xlcdirty = 1;
+}
+
+/**
+ * Write the cache file if modified
+ */
+int xlcsave(void)
+{
+    int      i;
+    size_t   n = 0;
+    size_t   x = 0;
+    char    *b;
+
+    if ((xfs == NULL) || (xlcdirty == 0))
+        return 0;
+    for (i = 0; i < xlcount; i++) {
+        n += xwcstoutf8(NULL, xlcents[i].vfile) + xwcstoutf8(NULL, xlcents[i].val) +
+             xwcstoutf8(NULL, xlcents[i].key) + 20;
+    }
+    b = xmalloc(n);
+    for (i = 0; i < xlcount; i++) {
+        unsigned long long mt = xlcents[i].mtime;
+        int d;
+
+        for (d = 60; d >= 0; d -= 4)
+            b[x++] = "0123456789abcdef"[(mt >> d) & 0x0F];
+        b[x++] = '\t';
+        x += xwcstoutf8(b + x, xlcents[i].vfile);
+        b[x++] = '\t';
+        x += xwcstoutf8(b + x, xlcents[i].val);
+        b[x++] = '\t';
+        x += xwcstoutf8(b + x, xlcents[i].key);
+        b[x++] = '\n';
+    }
+    i = xfs->writefile(xlcfile, b, x);
+    xmfree(b);
+    if (i == 0)
+        xlcdirty = 0;
+    return i;
+}
+
+static const char *xtracenames[XTRACE_PHASES] = {
+    "root",
+    "initenv",
+    "mounts",
+    "setupenv",
+    "search",
+    "args",
+    "env",
+    "cmdline",
+    "envblock",
+    "create",
+    "wait",
+    "total"
+};
+
+/**
+ * Format the trace record as single line of
+ * space separated name=value pairs, with phase
+ * times in microseconds.
+ * The buffer must have CYGWRUN_TRACE_LINE bytes.
+ */
+size_t xtraceline(char *b, const xtrace *t)
+{
+    int    i;
+    size_t n;
+    unsigned long long f = t->freq ? t->freq : 1;
+
+    n = sprintf(b, "pid=%lu rc=%d", t->pid, t->rc);
+    for (i = 0; i < XTRACE_PHASES; i++) {
+        unsigned long long us;
+
+        us = (t->tick[i] / f) * 1000000ULL + ((t->tick[i] % f) * 1000000ULL) / f;
+        n += sprintf(b + n, " %s=%llu", xtracenames[i], us);
+    }
+    n += sprintf(b + n, " nvars=%d xvars=%d skipvars=%d nargs=%d xargs=%d envblk=%llu"
+                        " pchits=%d pcmiss=%d pdhits=%d pdmiss=%d lchits=%d lcmiss=%d",
+                 t->envseen, t->envxlat, t->envskip, t->argseen, t->argxlat,
+                 (unsigned long long)t->envsize, xpchits, xpcmiss, xpdhits, xpdmiss,
+                 xlchits, xlcmiss);
+    if (!IS_EMPTY_STR(t->name))
+        n += sprintf(b + n, " exe=%.256s", t->name);
+    b[n++] = '\n';
+    b[n]   = 0;
+    return n;
+}
+
+/**
+ * Translation server.
+ *
+ * Clients send the arguments and the hash of their environment.
+ * Environment is translated only once for each hash and kept
+ * outside the arena, except for the zero hash that is translated
+ * for each request. The rest of the per request memory
+ * and the path cache are released after CYGWRUN_STREAM_RESET
+ * bytes of requests and responses.
+ *
+ * Each message is a header followed by the payload.
+ * Request payload is the environment hash, argument and
+ * environment count, followed by NUL terminated UTF-8
+ * current directory, arguments and environment strings.
+ * Successful response is three messages with the program,
+ * command line and environment block as wide strings.
+ * Error response is a single empty message with the error code.
+ */
+typedef struct xsrvhdr_t {
+    unsigned int        magic;
+    unsigned int        code;
+    unsigned int        size;
+} xsrvhdr;
+
+typedef struct xsrvenv_t {
+    unsigned long long  hash;
+    wchar_t            *blk;
+    unsigned int        used;
+} xsrvenv;
+
+#define CYGWRUN_SRVREQ_HDR  (sizeof(unsigned long long) + 2 * sizeof(unsigned int))
+
+static xsrvenv      xsrvenvs[CYGWRUN_SRVENV_MAX];
+static unsigned int xsrvclock    = 0;
+static size_t       xsrvbytes    = 0;
+#if CYGWRUN_USE_ARENA
+static xmemmark     xsrvmark;
+static int          xsrvmarked   = 0;
+#endif
+
+/**
+ * FNV-1a hash of the string and its terminating NUL
+ */
+unsigned long long xsrvhash(unsigned long long h, const char *s)
+{
+    if (h == 0)
+        h = 14695981039346656037ULL;
+    do {
+        h ^= (unsigned char)*s;
+        h *= 1099511628211ULL;
+    } while (*(s++));
+    return h;
+}
+
+static int xsrvsend(const xsrvops *o, void *c, int code, const void *p, size_t n)
+{
+    xsrvhdr h;
+
+    h.magic = CYGWRUN_SRV_MAGIC;
+    h.code  = (unsigned int)code;
+    h.size  = (unsigned int)n;
+    xsrvbytes += n;
+    if (o->send(c, &h, sizeof(xsrvhdr)))
+        return CYGWRUN_ENOSPC;
+    if ((n > 0) && o->send(c, p, n))
+        return CYGWRUN_ENOSPC;
+    return 0;
+}
+
+/**
+ * Receive the message payload.
+ * The payload is followed by two zero wide characters.
+ * Returns NULL on error or end of stream.
+ */
+static char *xsrvrecv(const xsrvops *o, void *c, int *code, size_t *n)
+{
+    xsrvhdr h;
+    char   *p;
+
+    if (o->recv(c, &h, sizeof(xsrvhdr)))
+        return NULL;
+    if ((h.magic != CYGWRUN_SRV_MAGIC) ||
+        (h.size > CYGWRUN_SRVMSG_MAX))
+        return NULL;
+    p = (char *)xalloc(h.size + 2 * sizeof(wchar_t));
+    if ((h.size > 0) && o->recv(c, p, h.size)) {
+        xmfree(p);
+        return NULL;
+    }
+    xsrvbytes += h.size;
+    *code = (int)h.code;
+    *n    = h.size;
+    return p;
+}
+
+static size_t xenvblocksize(const wchar_t *b)
+{
+    const wchar_t *e = b;
+
+    while (*e)
+        e += xwcslen(e) + 1;
+    return (size_t)(e - b + 1);
+}
+
+/**
+ * Find the environment context by hash, or create the
+ * new one in place of least recently used context.
+ */
+static xsrvenv *xsrvgetenv(const xsrvops *o, unsigned long long hash, const char **envp)
+{
+    int      i;
+    size_t   n;
+    wchar_t *b;
+    xsrvenv *e = &xsrvenvs[0];
+
+    for (i = 0; i < CYGWRUN_SRVENV_MAX; i++) {
+        if ((xsrvenvs[i].blk != NULL) && (xsrvenvs[i].hash == hash)) {
+            xsrvenvs[i].used = ++xsrvclock;
+            return &xsrvenvs[i];
+        }
+        if (xsrvenvs[i].used < e->used)
+            e = &xsrvenvs[i];
+    }
+    if (envp == NULL)
+        return NULL;
+    b = o->envblock(envp);
+    if (b == NULL)
+        return NULL;
+    n = xenvblocksize(b) * sizeof(wchar_t);
+    xkeepfree(e->blk);
+    e->blk  = (wchar_t *)xkeepalloc(n);
+    e->hash = hash;
+    e->used = ++xsrvclock;
+    memcpy(e->blk, b, n);
+    xmfree(b);
+    return e;
+}
+
+/**
+ * Translate single request and send the response
+ */
+static int xsrvrequest(const xsrvops *o, void *c, const char *p, size_t n)
+{
+    int          i;
+    int          rv = 0;
+    unsigned int argc;
+    unsigned int envc;
+    unsigned long long hash;
+    const char  *e = p + n;
+    const char **sa;
+    wchar_t    **wa;
+    wchar_t     *cmd;
+    wchar_t     *exe;
+    wchar_t     *name;
+    wchar_t     *blk;
+    xsrvenv     *env;
+
+    if (n < CYGWRUN_SRVREQ_HDR)
+        return xsrvsend(o, c, CYGWRUN_EINVAL, NULL, 0);
+    memcpy(&hash, p, sizeof(hash));
+    memcpy(&argc, p + sizeof(hash), sizeof(argc));
+    memcpy(&envc, p + sizeof(hash) + sizeof(argc), sizeof(envc));
+    p += CYGWRUN_SRVREQ_HDR;
+    n -= CYGWRUN_SRVREQ_HDR;
+    /**
+     * Each string takes at least one byte of the payload,
+     * so the counts are checked separately against the
+     * remaining size before they are added together
+     */
+    if ((argc < 1) || ((size_t)argc >= n) || ((size_t)envc > n - argc - 1))
+        return xsrvsend(o, c, CYGWRUN_EINVAL, NULL, 0);
+    /**
+     * Current directory, arguments and environment
+     */
+    sa = (const char **)xsaalloc(argc + envc + 1);
+    for (i = 0; i < (int)(argc + envc + 1); i++) {
+        sa[i] = p;
+        while ((p < e) && *p)
+            p++;
+        if (p++ == e) {
+            xmfree((void *)sa);
+            return xsrvsend(o, c, CYGWRUN_EINVAL, NULL, 0);
+        }
+    }
+    if (hash == 0) {
+        blk = envc ? o->envblock(sa + argc + 1) : NULL;
+    }
+    else {
+        env = xsrvgetenv(o, hash, envc ? sa + argc + 1 : NULL);
+        blk = env ? env->blk : NULL;
+    }
+    if (blk == NULL) {
+        xmfree((void *)sa);
+        return xsrvsend(o, c, CYGWRUN_ENOENV, NULL, 0);
+    }
+    wa = xmbsslab(sa, argc + 1);
+    xmfree((void *)sa);
+    name = pathtowin(xwcsdup(wa[1]));
+    exe  = IS_EMPTY_WCS(name) ? NULL : o->findexe(name, wa[0], blk);
+    xmfree(name);
+    if (exe == NULL) {
+        if (hash == 0)
+            xmfree(blk);
+        xmfree(wa);
+        return xsrvsend(o, c, CYGWRUN_ENOEXEC, NULL, 0);
+    }
+    wa[1] = exe;
+    for (i = 2; i <= (int)argc; i++)
+        wa[i] = argtowin(wa[i]);
+    n = xcmdlinelen(argc, (const wchar_t **)wa + 1);
+    if (!xcmdlinefits(n)) {
+        rv = xsrvsend(o, c, CYGWRUN_ERANGE, NULL, 0);
+    }
+    else {
+        cmd = xcmdline(argc, (const wchar_t **)wa + 1, n);
+        rv  = xsrvsend(o, c, 0, exe, (xwcslen(exe) + 1) * sizeof(wchar_t));
+        if (rv == 0)
+            rv = xsrvsend(o, c, 0, cmd, (n + 1) * sizeof(wchar_t));
+        if (rv == 0)
+            rv = xsrvsend(o, c, 0, blk, xenvblocksize(blk) * sizeof(wchar_t));
+        xmfree(cmd);
+    }
+    if (hash == 0)
+        xmfree(blk);
+    for (i = 1; i <= (int)argc; i++)
+        xmfree(wa[i]);
+    xmfree(wa);
+    return rv;
+}
+
+/**
+ * Serve requests from the connection until the end of stream
+ */
+int xsrvloop(const xsrvops *o, void *c)
+{
+    int    rv = 0;
+    int    code;
+    size_t n;
+    char  *p;
+
+#if CYGWRUN_USE_ARENA
+    if (xsrvmarked == 0) {
+        xmemsave(&xsrvmark);
+        xsrvmarked = 1;
+    }
+#endif
+    while (rv == 0) {
+        p = xsrvrecv(o, c, &code, &n);
+        if (p == NULL)
+            break;
+        rv = xsrvrequest(o, c, p, n);
+        xmfree(p);
+#if CYGWRUN_USE_ARENA
+        if (xsrvbytes > CYGWRUN_STREAM_RESET) {
+            xpcclear();
+            xmemrestore(&xsrvmark);
+            xsrvbytes = 0;
+        }
+#endif
+    }
+    return rv;
+}
+
+static char *xsrvputs(char *d, const char *s)
+{
+    size_t n = xstrlen(s);
+
+    if (n > 0)
+        memcpy(d, s, n);
+    d[n] = 0;
+    return d + n + 1;
+}
+
+static int xsrvput(const xsrvops *o, void *c, const xsrvreq *r, int envc)
+{
+    int          i;
+    int          rv;
+    unsigned int u;
+    size_t       n = CYGWRUN_SRVREQ_HDR + xstrlen(r->cwd) + 1;
+    char        *p;
+    char        *d;
+
+    for (i = 0; i < r->argc; i++)
+        n += xstrlen(r->argv[i]) + 1;
+    for (i = 0; i < envc; i++)
+        n += xstrlen(r->envp[i]) + 1;
+    if (n > CYGWRUN_SRVMSG_MAX)
+        return CYGWRUN_ERANGE;
+    p = xmalloc(n);
+    memcpy(p, &r->hash, sizeof(r->hash));
+    u = (unsigned int)r->argc;
+    memcpy(p + sizeof(r->hash), &u, sizeof(u));
+    u = (unsigned int)envc;
+    memcpy(p + sizeof(r->hash) + sizeof(u), &u, sizeof(u));
+    d = xsrvputs(p + CYGWRUN_SRVREQ_HDR, r->cwd);
+    for (i = 0; i < r->argc; i++)
+        d = xsrvputs(d, r->argv[i]);
+    for (i = 0; i < envc; i++)
+        d = xsrvputs(d, r->envp[i]);
+    rv = xsrvsend(o, c, 0, p, n);
+    xmfree(p);
+    return rv;
+}
+
+static int xsrvget(const xsrvops *o, void *c, xsrvres *r)
+{
+    int    code;
+    size_t n;
+    char  *p;
+
+    p = xsrvrecv(o, c, &code, &n);
+    if (p == NULL)
+        return CYGWRUN_ENOSPC;
+    if (code != 0) {
+        xmfree(p);
+        return code;
+    }
+    r->exe = (wchar_t *)p;
+    p = xsrvrecv(o, c, &code, &n);
+    if (p == NULL)
+        return CYGWRUN_ENOSPC;
+    r->cmdline = (wchar_t *)p;
+    p = xsrvrecv(o, c, &code, &n);
+    if (p == NULL)
+        return CYGWRUN_ENOSPC;
+    r->envblk = (wchar_t *)p;
+    return 0;
+}
+
+/**
+ * Send the request to the server and receive the response.
+ * The environment is sent only if the server does not
+ * know the environment hash, or with each zero hash request.
+ * Returns zero on success or the server error code.
+ */
+int xsrvcall(const xsrvops *o, void *c, const xsrvreq *r, xsrvres *rs)
+{
+    int rv;
+    int envc = 0;
+
+    memset(rs, 0, sizeof(xsrvres));
+    if ((r->hash == 0) && (r->envp != NULL)) {
+        while (r->envp[envc])
+            envc++;
+    }
+    rv = xsrvput(o, c, r, envc);
+    if (rv == 0)
+        rv = xsrvget(o, c, rs);
+    if ((rv == CYGWRUN_ENOENV) && (r->envp != NULL) && (r->hash != 0)) {
+        while (r->envp[envc])
+            envc++;
+        rv = xsrvput(o, c, r, envc);
+        if (rv == 0)
+            rv = xsrvget(o, c, rs);
+    }
+    return rv;
+}
@@ -0,0 +1,536 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _CYGWCORE_H_INCLUDED_
+#define _CYGWCORE_H_INCLUDED_
+
+/**
+ * Portable path translation engine.
+ *
+ * Everything declared here is pure string processing
+ * and does not depend on Win32 API, so it can be compiled
+ * and tested natively on any posix host.
+ */
+#include <stddef.h>
+#include <stdio.h>
+#include <wchar.h>
+#include "cygwrun.h"
+
+/**
+ * Use bump pointer arena allocator.
+ * Memory is taken from large zero filled chunks
+ * and it is never freed before the process exits.
+ */
+#if !defined(CYGWRUN_USE_ARENA)
+# define CYGWRUN_USE_ARENA          1
+#endif
+#define CYGWRUN_ARENA_CHUNK   1048576   /** Size of single arena chunk  */
+/**
+ * Print memory statistics on exit
+ */
+#if !defined(CYGWRUN_USE_MEMSTAT)
+# define CYGWRUN_USE_MEMSTAT        0
+#endif
+/**
+ * Record call site, size and lifetime of each
+ * allocation and print the allocation profile on exit.
+ * Available only for dev versions.
+ */
+#if !defined(CYGWRUN_USE_MEMPROF) || !CYGWRUN_ISDEV_VERSION
+# undef  CYGWRUN_USE_MEMPROF
+# define CYGWRUN_USE_MEMPROF        0
+#endif
+#define CYGWRUN_MEMPROF_SITES     256   /** Maximum number of sites     */
+/**
+ * Use SSE2/AVX2 kernels for scanning wide strings.
+ * AVX2 kernels are used when compiled with -mavx2 or /arch:AVX2
+ */
+#if !defined(CYGWRUN_USE_SIMD)
+# if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#  define CYGWRUN_USE_SIMD          1
+# else
+#  define CYGWRUN_USE_SIMD          0
+# endif
+#endif
+/**
+ * Cache translated path elements
+ */
+#if !defined(CYGWRUN_USE_PATHCACHE)
+# define CYGWRUN_USE_PATHCACHE      1
+#endif
+#define CYGWRUN_PATHCACHE_SIZE   1024   /** Must be power of two        */
+#define CYGWRUN_DIRCACHE_SIZE    256    /** Must be power of two        */
+/**
+ * Use Win32 heapapi instead malloc/free
+ */
+#if !defined(CYGWRUN_USE_HEAPAPI)
+# if defined(_WIN32)
+#  define CYGWRUN_USE_HEAPAPI       1
+# else
+#  define CYGWRUN_USE_HEAPAPI       0
+# endif
+#endif
+#define CYGWRUN_USE_PRIVATE_HEAP    0
+/**
+ * Call HeapFree/free
+ * Set this value to 1 for dev versions
+ */
+#if !defined(CYGWRUN_USE_MEMFREE) || CYGWRUN_USE_ARENA
+# undef  CYGWRUN_USE_MEMFREE
+# define CYGWRUN_USE_MEMFREE        0
+#endif
+
+#if !defined(__GNUC__) && !defined(_MSC_VER)
+# define __inline
+#endif
+
+#define CYGWRUN_ERRMAX            110
+#define CYGWRUN_FAILED            126
+#define CYGWRUN_ENOEXEC           127
+#define CYGWRUN_SIGBASE           128
+
+#define CYGWRUN_ENOSYS            111   /** Cannot find cygwin root     */
+#define CYGWRUN_EINVAL            112
+#define CYGWRUN_EPARAM            113
+#define CYGWRUN_EALREADY          114
+#define CYGWRUN_ENOENT            115
+#define CYGWRUN_EEMPTY            116
+#define CYGWRUN_EBADPATH          117
+
+#define CYGWRUN_ENOSPC            118
+#define CYGWRUN_ENOENV            119
+#define CYGWRUN_EBADENV           120
+#define CYGWRUN_ENOMEM            121
+#define CYGWRUN_ERANGE            122
+
+#define CYGWRUN_MAX_ALLOC  (((size_t)-1) / 16)  /** Overflow safe alloc size */
+#define CYGWRUN_SLAB_SIZE      131072   /** String slab segment size    */
+#define CYGWRUN_SRVMSG_MAX   0x4000000  /** Server message size limit   */
+#define CYGWRUN_PATH_MAX         4096
+#define CYGWRUN_MAX_MOUNTS         64
+#define CYGWRUN_LCACHE_MAX         64   /** Launch cache entries        */
+#define CYGWRUN_STREAM_BUFSIZ   65536   /** Stream mode buffer size     */
+#define CYGWRUN_STREAM_RESET  1048576   /** Release memory after bytes  */
+#define CYGWRUN_RSPBUF_SIZE     16384   /** Response file read size     */
+#define CYGWRUN_RSPARG_MAX      16384   /** Response file argument init */
+#define CYGWRUN_CMDLINE_MAX     32767   /** CreateProcess command line  */
+#define CYGWRUN_TRACE_LINE       1024   /** Trace record buffer size    */
+#define CYGWRUN_SRVENV_MAX         16   /** Server environment contexts */
+#define CYGWRUN_SRV_MAGIC  0x57474359   /** Server message magic        */
+
+#define IS_PSW(_c)              (((_c) == L'/') || ((_c)  == L'\\'))
+#define IS_EMPTY_WCS(_s)        (((_s) == NULL) || (*(_s) == 0))
+#define IS_EMPTY_STR(_s)        (((_s) == NULL) || (*(_s) == 0))
+
+
+/**
+ * Character classes for xwcsscan.
+ * Each scan also stops at the string terminator.
+ */
+#define XSCAN_NUL               0   /** Terminator only             */
+#define XSCAN_CHR               1   /** Single character            */
+#define XSCAN_SEP               2   /** Path and list separators    */
+#define XSCAN_QUOTE             3   /** Spaces and double quote     */
+#define XSCAN_PSWDOT            4   /** Path separators and dot     */
+
+/**
+ * String view.
+ * Pointer and length of the string part,
+ * that is not required to be zero terminated.
+ */
+typedef struct xwcsview_t {
+    const wchar_t *s;
+    size_t         n;
+} xwcsview;
+
+/**
+ * Align to 16 bytes
+ */
+#define CYGWRUN_ALIGN(_S)       (((_S) + 0x0000000F) & ~((size_t)0x0000000F))
+
+/**
+ * Mount table entry and prefix trie node
+ */
+typedef struct xmount_t {
+    wchar_t *src;                       /** Posix mount point           */
+    wchar_t *dst;                       /** Windows path                */
+    size_t   slen;
+    size_t   dlen;
+} xmount;
+
+typedef struct xmnode_t {
+    wchar_t  c;
+    int      cygdrive;                  /** Node is cygdrive prefix     */
+    int      mount;                     /** Index of mount point or -1  */
+    int      child;
+    int      next;
+} xmnode;
+
+/**
+ * Compiled set of name patterns.
+ * Each pattern character except '*' is one bit of the state.
+ */
+#define XPS_BITS                32
+#define XPS_NMASKS              0x81
+#define XPS_SET(_b, _i)         (_b)[(_i) / XPS_BITS] |= 1U << ((_i) % XPS_BITS)
+
+typedef struct xpatset_t {
+    int           npats;
+    int           npos;
+    int           nwords;
+    int           anyx;                 /** First pattern matching all  */
+    int           hasuni;
+    int          *patx;                 /** Pattern index of each state */
+    wchar_t      *hilit;                /** Non ascii literals          */
+    unsigned int *masks;                /** States accepting character  */
+    unsigned int *first;                /** First state of each pattern */
+    unsigned int *init;                 /** Patterns starting with '*'  */
+    unsigned int *loop;                 /** States followed by '*'      */
+    unsigned int *last;                 /** Final state of each pattern */
+    unsigned int *state;
+} xpatset;
+
+/**
+ * Path element translation cache entry
+ */
+typedef struct xpcentry_t {
+    wchar_t      *key;
+    wchar_t      *val;
+    size_t        klen;
+    size_t        vlen;
+    unsigned int  hash;
+    int           nopos;                /** Element is not posix path   */
+    int           rev;                  /** Windows to posix entry      */
+} xpcentry;
+
+/**
+ * File system operations used by the launch cache.
+ * Each function returns zero on success.
+ */
+typedef struct xfsops_t {
+    int       (*mtime)(const wchar_t *, unsigned long long *);
+    wchar_t  *(*readfile)(const wchar_t *);
+    int       (*writefile)(const wchar_t *, const char *, size_t);
+} xfsops;
+
+/**
+ * Invocation trace phases
+ */
+#define XTRACE_ROOT                 0   /** Cygwin root discovery       */
+#define XTRACE_INITENV              1   /** initenvironment             */
+#define XTRACE_MOUNTS               2   /** Mount table and fstab       */
+#define XTRACE_SETUPENV             3   /** setupenvironment and PATH   */
+#define XTRACE_SEARCH               4   /** Program search              */
+#define XTRACE_ARGS                 5   /** Argument translation        */
+#define XTRACE_ENV                  6   /** Environment translation     */
+#define XTRACE_CMDLINE              7   /** Command line                */
+#define XTRACE_ENVBLOCK             8   /** getenvblock                 */
+#define XTRACE_CREATE               9   /** CreateProcessW              */
+#define XTRACE_WAIT                10   /** Wait for child process      */
+#define XTRACE_TOTAL               11
+#define XTRACE_PHASES              12
+
+/**
+ * Timings and counts of a single invocation.
+ * Time is in ticks of freq per second.
+ */
+typedef struct xtrace_t {
+    unsigned long long  freq;
+    unsigned long long  tick[XTRACE_PHASES];
+    unsigned long       pid;
+    int                 rc;
+    int                 envseen;        /** Variables seen              */
+    int                 envxlat;        /** Variables translated        */
+    int                 envskip;        /** Variables skipped           */
+    int                 argseen;
+    int                 argxlat;
+    size_t              envsize;        /** Environment block bytes     */
+    const char         *name;           /** Program name                */
+} xtrace;
+
+/**
+ * Translation server transport and platform operations.
+ * The recv and send functions transfer exactly n bytes
+ * and return zero on success.
+ */
+typedef struct xsrvops_t {
+    int       (*recv)(void *, void *, size_t);
+    int       (*send)(void *, const void *, size_t);
+    wchar_t  *(*envblock)(const char **);
+    wchar_t  *(*findexe)(const wchar_t *, const wchar_t *, const wchar_t *);
+} xsrvops;
+
+/**
+ * Server request.
+ * The envp is sent only if the server does not
+ * have the environment with the same hash.
+ * Zero hash is never cached, and its envp is
+ * sent with each request.
+ */
+typedef struct xsrvreq_t {
+    unsigned long long  hash;
+    const char         *cwd;
+    int                 argc;
+    const char        **argv;
+    const char        **envp;
+} xsrvreq;
+
+typedef struct xsrvres_t {
+    wchar_t            *exe;
+    wchar_t            *cmdline;
+    wchar_t            *envblk;
+} xsrvres;
+
+typedef struct xlcentry_t {
+    wchar_t            *key;
+    wchar_t            *val;
+    wchar_t            *vfile;          /** File that validates entry   */
+    unsigned long long  mtime;
+} xlcentry;
+
+/**
+ * Engine state shared with the caller
+ */
+extern wchar_t    *posixroot;
+extern int         xrmendps;
+extern wchar_t     zerowcs[8];
+extern int         xpchits;
+extern int         xpcmiss;
+extern int         xpdhits;
+extern int         xpdmiss;
+extern int         xlchits;
+extern int         xlcmiss;
+#if CYGWRUN_ISDEV_VERSION
+extern size_t      xzalloc;
+extern size_t      xzpeak;
+extern int         xnalloc;
+extern int         xnmfree;
+extern int         xnchunk;
+#endif
+
+
+static __inline int xisalpha(int c)
+{
+    return ((c >= 0x41 && c <= 0x5A) || (c >= 0x61 && c <= 0x7A));
+}
+
+static __inline int xisalnum(int c)
+{
+    return ((c >= 0x41 && c <= 0x5A) || (c >= 0x61 && c <= 0x7A) ||
+            (c >= 0x30 && c <= 0x39));
+}
+
+static __inline int xisnonchar(int c)
+{
+    return (c > 0 && c <= 0x20);
+}
+
+static __inline int xisspace(int c)
+{
+    return ((c >= 0x09 && c <= 0x0D) || (c == 0x20));
+}
+
+static __inline int xisvarchar(int c)
+{
+    return (xisalnum(c) || c == 0x2D || c == 0x5F);
+}
+
+/**
+ * Check if the command line of n characters, as
+ * returned by xcmdlinelen, fits into CreateProcess
+ * limit, that includes the terminating zero.
+ */
+static __inline int xcmdlinefits(size_t n)
+{
+    return (n < CYGWRUN_CMDLINE_MAX);
+}
+
+static __inline int xtolower(int c)
+{
+    return (c >= 0x41 && c <= 0x5A) ? c ^ 0x20 : c;
+}
+
+static __inline int xtoupper(int c)
+{
+    return (c >= 0x61 && c <= 0x7A) ? c ^ 0x20 : c;
+}
+
+/**
+ * Environment variable classes.
+ * The name table is generated by mkenvhash from cygwenv.lst
+ */
+#define XENV_PASS               0
+#define XENV_UNSET              1
+#define XENV_CONFIG             2
+
+typedef struct xenvname_t {
+    const char  *name;
+    int          len;
+    int          type;
+    int          index;
+} xenvname;
+
+/**
+ * Case insensitive FNV-1a hash of the first n characters of s
+ */
+static __inline unsigned int xenvhash(const char *s, size_t n, unsigned int seed)
+{
+    unsigned int h = 2166136261U ^ seed;
+
+    while (n-- > 0) {
+        h ^= (unsigned int)xtoupper((unsigned char)*(s++));
+        h *= 16777619U;
+    }
+    return h ^ (h >> 15);
+}
+
+/**
+ * Memory
+ */
+int         xmeminit(void);
+void        xmemdone(void);
+void       *xalloc(size_t);
+wchar_t    *xwalloc(size_t);
+char       *xmalloc(size_t);
+void       *xcalloc(size_t, size_t);
+wchar_t   **xwaalloc(size_t);
+char      **xsaalloc(size_t);
+wchar_t   **xmbsslab(const char **, int);
+#if CYGWRUN_USE_MEMFREE
+void        xmfree(void *);
+void        xafree(void **);
+#else
+#define xmfree(_m)      (void)0
+#define xafree(_m)      (void)0
+#endif
+
+/**
+ * Strings
+ */
+size_t      xstrlen(const char *);
+size_t      xutf8towcs(wchar_t *, const char *);
+size_t      xwcstoutf8(char *, const wchar_t *);
+size_t      xwcslen(const wchar_t *);
+wchar_t    *xwcsscan(const wchar_t *, int, wchar_t);
+wchar_t    *xwcsdup(const wchar_t *);
+wchar_t    *xwcsndup(const wchar_t *, size_t);
+char       *xstrdup(const char *);
+wchar_t    *xwcschr(const wchar_t *, const wchar_t *, wchar_t);
+char       *xstrchr(const char *, const char *, int);
+size_t      xstrchrn(const char *, char);
+wchar_t    *xwcsconcat(const wchar_t *, const wchar_t *, wchar_t);
+wchar_t    *xwcsappend(wchar_t *, const wchar_t *, wchar_t);
+char       *xstrappend(char *, const char *, char);
+wchar_t    *xwcstrim(wchar_t *);
+char       *xstrtrim(char *);
+char       *xstrbegins(int, const char *, const char *);
+char       *xstrnbegins(int, const char *, const char *, size_t);
+int         xstrnicmp(const char *, const char *, size_t);
+int         xwcsbegins(const wchar_t *, const wchar_t *);
+int         xwcsequals(const wchar_t *, const wchar_t *, wchar_t);
+int         xwcsicmp(const wchar_t *, const wchar_t *);
+int         xwcsnicmp(const wchar_t *, const wchar_t *, size_t);
+int         xstricmp(const char *, const char *);
+int         xwcsimatch(const wchar_t *, const wchar_t *);
+int         xstrimatch(const char *, const char *);
+xpatset    *xpatcompile(const wchar_t **, const wchar_t *, wchar_t);
+int         xpatmatch(const xpatset *, const wchar_t *);
+int         xwcsnext(const wchar_t **, wchar_t, xwcsview *);
+int         xstrntok(const char *, char);
+char       *xstrctok(char *, char, char **);
+int         xneedsquote(const wchar_t *);
+wchar_t    *xwcsquote(wchar_t *);
+wchar_t    *xquotearg(wchar_t *);
+int         xmszcount(const wchar_t *);
+wchar_t    *warraytomsz(int, const wchar_t **, wchar_t);
+size_t      xcmdlinelen(int, const wchar_t **);
+wchar_t    *xcmdline(int, const wchar_t **, size_t);
+wchar_t   **wcstoarray(const wchar_t *, wchar_t);
+char      **strtoarray(const char *, char);
+
+/**
+ * Path translation
+ */
+int         iswinpath(const wchar_t *);
+int         isdotpath(const wchar_t *);
+int         ispathlist(const wchar_t *);
+int         initmounts(const wchar_t *);
+int         isposixpath(const wchar_t *);
+int         isanypath(int, wchar_t *);
+wchar_t    *cmdoptionval(wchar_t *);
+wchar_t    *wcleanpath(wchar_t *);
+wchar_t    *posixtowin(wchar_t *, int);
+wchar_t    *pathtowin(wchar_t *);
+wchar_t    *pathstowin(const wchar_t *);
+wchar_t    *anypathtowin(const wchar_t *);
+wchar_t    *prunepath(const wchar_t *, int (*)(const wchar_t *));
+wchar_t    *argtowin(wchar_t *);
+wchar_t    *wintoposix(wchar_t *);
+wchar_t    *pathstoposix(const wchar_t *);
+wchar_t    *argtoposix(wchar_t *);
+wchar_t    *getenvblock(wchar_t **, wchar_t **);
+int         xstreamtowin(FILE *, FILE *, int);
+int         xstreamtoposix(FILE *, FILE *, int);
+int         xrsptowin(FILE *, FILE *);
+int         xargstorsp(FILE *, int, const wchar_t **, int);
+
+/**
+ * Launch cache
+ */
+int         xlcinit(const xfsops *, const wchar_t *);
+wchar_t    *xlcget(const wchar_t *);
+void        xlcput(const wchar_t *, const wchar_t *, const wchar_t *);
+int         xlcsave(void);
+
+/**
+ * Invocation trace
+ */
+size_t      xtraceline(char *, const xtrace *);
+
+/**
+ * Translation server
+ */
+unsigned long long xsrvhash(unsigned long long, const char *);
+int         xsrvloop(const xsrvops *, void *);
+int         xsrvcall(const xsrvops *, void *, const xsrvreq *, xsrvres *);
+
+#if CYGWRUN_USE_MEMPROF
+/**
+ * Allocation profiler.
+ * Each allocation function records the name of the
+ * function that called it, before doing the allocation.
+ */
+void        xmemprofsite(const char *, const char *);
+void        xmemprof(FILE *);
+
+#define XMEMPROF_CALL(_w, _c)   (xmemprofsite(_w, __func__), _c)
+#define xalloc(_s)              XMEMPROF_CALL("xalloc",     xalloc(_s))
+#define xwalloc(_s)             XMEMPROF_CALL("xwalloc",    xwalloc(_s))
+#define xmalloc(_s)             XMEMPROF_CALL("xmalloc",    xmalloc(_s))
+#define xcalloc(_n, _s)         XMEMPROF_CALL("xcalloc",    xcalloc(_n, _s))
+#define xwaalloc(_s)            XMEMPROF_CALL("xwaalloc",   xwaalloc(_s))
+#define xsaalloc(_s)            XMEMPROF_CALL("xsaalloc",   xsaalloc(_s))
+#define xmbsslab(_a, _n)        XMEMPROF_CALL("xmbsslab",   xmbsslab(_a, _n))
+#define xwcsdup(_s)             XMEMPROF_CALL("xwcsdup",    xwcsdup(_s))
+#define xwcsndup(_s, _n)        XMEMPROF_CALL("xwcsndup",   xwcsndup(_s, _n))
+#define xstrdup(_s)             XMEMPROF_CALL("xstrdup",    xstrdup(_s))
+#define xwcsconcat(_a, _b, _c)  XMEMPROF_CALL("xwcsconcat", xwcsconcat(_a, _b, _c))
+#define xwcsappend(_a, _b, _c)  XMEMPROF_CALL("xwcsappend", xwcsappend(_a, _b, _c))
+#define xstrappend(_a, _b, _c)  XMEMPROF_CALL("xstrappend", xstrappend(_a, _b, _c))
+#endif
+
+#endif /* _CYGWCORE_H_INCLUDED_ */
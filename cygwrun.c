@@ -18,1493 +18,109 @@
 #include <windows.h>
 #include <tlhelp32.h>
 #include <stdio.h>
+#include <fcntl.h>
+#include <io.h>
 #include <stdlib.h>
 #include <string.h>
 #include <wchar.h>
-#include "cygwrun.h"
+#include "cygwcore.h"
+#include "cygwenv.h"
 
 /**
- * Use Win32 heapapi instead malloc/free
- */
-#define CYGWRUN_USE_HEAPAPI         1
-#define CYGWRUN_USE_PRIVATE_HEAP    0
-/**
- * Call HeapFree/free
- * Set this value to 1 for dev versions
- */
-#define CYGWRUN_USE_MEMFREE         0
-/**
- * Use -s and -u command options
- */
-#define CYGWRUN_HAVE_CMDOPTS        0
-
-#define CYGWRUN_ERRMAX            110
-#define CYGWRUN_FAILED            126
-#define CYGWRUN_ENOEXEC           127
-#define CYGWRUN_SIGBASE           128
-
-#define CYGWRUN_ENOSYS            111   /** Cannot find cygwin root     */
-#define CYGWRUN_EINVAL            112
-#define CYGWRUN_EPARAM            113
-#define CYGWRUN_EALREADY          114
-#define CYGWRUN_ENOENT            115
-#define CYGWRUN_EEMPTY            116
-#define CYGWRUN_EBADPATH          117
-
-#define CYGWRUN_ENOSPC            118
-#define CYGWRUN_ENOENV            119
-#define CYGWRUN_EBADENV           120
-#define CYGWRUN_ENOMEM            121
-#define CYGWRUN_ERANGE            122
-
-#define CYGWRUN_MAX_ALLOC      131072   /** Limit single alloc to 128K  */
-#define CYGWRUN_PATH_MAX         4096
-#define CYGWRUN_KILL_DEPTH          4
-#define CYGWRUN_KILL_SIZE         256
-#define CYGWRUN_KILL_TIMEOUT      500
-#define CYGWRUN_CRTL_C_WAIT      2000
-#define CYGWRUN_CRTL_S_WAIT      3000
-
-#define CYGWRUN_SIGINT          (CYGWRUN_SIGBASE +  2)
-#define CYGWRUN_SIGTERM         (CYGWRUN_SIGBASE + 15)
-
-#define IS_PSW(_c)              (((_c) == L'/') || ((_c)  == L'\\'))
-#define IS_EMPTY_WCS(_s)        (((_s) == NULL) || (*(_s) == 0))
-#define IS_EMPTY_STR(_s)        (((_s) == NULL) || (*(_s) == 0))
-
-
-/**
- * Align to 16 bytes
- */
-#define CYGWRUN_ALIGN(_S)       (((_S) + 0x0000000F) & 0xFFFFFFF0)
-
-#if CYGWRUN_USE_HEAPAPI
-static HANDLE      memheap      = NULL;
-#if CYGWRUN_USE_MEMFREE && CYGWRUN_ISDEV_VERSION
-static size_t      xzmfree      = 0;
-#endif
-#endif
-
-static HANDLE      conevent     = NULL;
-static HANDLE      cprocess     = NULL;
-static int         xrmendps     = L'\\';
-static int         xenvcount    = 0;
-#if CYGWRUN_USE_MEMFREE && CYGWRUN_ISDEV_VERSION
-static size_t      xzalloc      = 0;
-static int         xnalloc      = 0;
-static int         xnmfree      = 0;
-#endif
-static wchar_t    *posixroot    = NULL;
-static wchar_t    *posixpath    = NULL;
-
-static wchar_t   **xenvvars     = NULL;
-static wchar_t   **xenvvals     = NULL;
-static wchar_t   **askipenv     = NULL;
-static char      **adelenvv     = NULL;
-
-static char      **systemenvn   = NULL;
-static char      **systemenvv   = NULL;
-static int         systemenvc   = 0;
-
-static const char *configvals[8]    = { NULL };
-static wchar_t     zerowcs[8]       = { 0 };
-
-typedef enum {
-    CYGWRUN_PATH     = 0,
-    CYGWRUN_SKIP,
-    CYGWRUN_UNSET,
-    CCYGWIN_PATH,
-    CCYGWIN_TEMP,
-    CCYGWIN_TMP
-
-} CYGWRUN_CONFIG_VARS;
-
-static const char *configvars[]     = {
-    "CYGWRUN_PATH",
-    "CYGWRUN_SKIP",
-    "CYGWRUN_UNSET",
-    "PATH",
-    "TEMP",
-    "TMP",
-    NULL
-};
-
-static const wchar_t *rootpaths[]   = {
-    L"/bin/",
-    L"/dev/",
-    L"/etc/",
-    L"/home/",
-    L"/lib/",
-    L"/sbin/",
-    L"/tmp/",
-    L"/usr/",
-    L"/var/",
-    NULL
-};
-
-static const char *sskipenv =
-    "COMPUTERNAME,HOMEDRIVE,HOMEPATH,HOST," \
-    "HOSTNAME,LOGONSERVER,PATH,PATHEXT,PROCESSOR_@*,PROMPT,USER,USERNAME";
-
-static const char *unsetvars[] = {
-    "ERRORLEVEL",
-    "EXECIGNORE",
-    "INFOPATH",
-    "LANG",
-    "OLDPWD",
-    "ORIGINAL_PATH",
-    "PROFILEREAD",
-    "PS1",
-    "PWD",
-    "SHELL",
-    "SHLVL",
-    "TERM",
-    "TZ",
-    NULL
-};
-
-
-static __inline int xisalpha(int c)
-{
-    return ((c >= 0x41 && c <= 0x5A) || (c >= 0x61 && c <= 0x7A));
-}
-
-static __inline int xisalnum(int c)
-{
-    return ((c >= 0x41 && c <= 0x5A) || (c >= 0x61 && c <= 0x7A) ||
-            (c >= 0x30 && c <= 0x39));
-}
-
-static __inline int xisnonchar(int c)
-{
-    return (c > 0 && c <= 0x20);
-}
-
-static __inline int xisspace(int c)
-{
-    return ((c >= 0x09 && c <= 0x0D) || (c == 0x20));
-}
-
-static __inline int xisvarchar(int c)
-{
-    return (xisalnum(c) || c == 0x2D || c == 0x5F);
-}
-
-static __inline int xtolower(int c)
-{
-    return (c >= 0x41 && c <= 0x5A) ? c ^ 0x20 : c;
-}
-
-static __inline int xtoupper(int c)
-{
-    return (c >= 0x61 && c <= 0x7A) ? c ^ 0x20 : c;
-}
-
-static size_t xstrlen(const char *src)
-{
-    const char *s = src;
-
-    if (IS_EMPTY_STR(s))
-        return 0;
-    while (*s)
-        s++;
-    return (size_t)(s - src);
-}
-
-static size_t xwcslen(const wchar_t *src)
-{
-    const wchar_t *s = src;
-
-    if (IS_EMPTY_WCS(s))
-        return 0;
-    while (*s)
-        s++;
-    return (size_t)(s - src);
-}
-
-static void *xalloc(size_t size)
-{
-    size_t s;
-    void  *p;
-
-    s = CYGWRUN_ALIGN(size);
-    if (s > CYGWRUN_MAX_ALLOC)
-        exit(CYGWRUN_ERANGE);
-#if CYGWRUN_USE_HEAPAPI
-    p = HeapAlloc(memheap, HEAP_ZERO_MEMORY, s);
-#else
-    p = calloc(1, s);
-#endif
-    if (p == NULL)
-        exit(CYGWRUN_ENOMEM);
-#if CYGWRUN_USE_MEMFREE && CYGWRUN_ISDEV_VERSION
-    xzalloc += s;
-    xnalloc++;
-#endif
-    return p;
-}
-
-static wchar_t *xwalloc(size_t size)
-{
-    return (wchar_t *)xalloc((size + 2) * sizeof(wchar_t));
-}
-
-static char *xmalloc(size_t size)
-{
-    return (char *)xalloc(size + 2);
-}
-
-static void *xcalloc(size_t number, size_t size)
-{
-    return xalloc((number + 2) * size);
-}
-
-static wchar_t **xwaalloc(size_t size)
-{
-    return (wchar_t **)xcalloc(size, sizeof(wchar_t *));
-}
-
-static char **xsaalloc(size_t size)
-{
-    return (char **)xcalloc(size, sizeof(char *));
-}
-
-#if CYGWRUN_USE_MEMFREE
-static void xmfree(void *m)
-{
-    if (m != NULL && m != zerowcs) {
-#if CYGWRUN_USE_HEAPAPI
-#if CYGWRUN_ISDEV_VERSION
-        xzmfree += HeapSize(memheap, 0, m);
-#endif
-        HeapFree(memheap, 0, m);
-#else
-        free(m);
-#endif
-#if CYGWRUN_ISDEV_VERSION
-        xnmfree++;
-#endif
-    }
-}
-
-static void xafree(void **array)
-{
-    void **ptr = array;
-
-    if (array == NULL)
-        return;
-    while (*ptr != NULL)
-        xmfree(*(ptr++));
-    xmfree(array);
-}
-#else
-#define xmfree(_m)      (void)0
-#define xafree(_m)      (void)0
-#endif
-
-
-static wchar_t *xwcsdup(const wchar_t *s)
-{
-    wchar_t *p;
-    size_t   n;
-
-    n = xwcslen(s);
-    if (n == 0)
-        return NULL;
-    p = xwalloc(n);
-    return wmemcpy(p, s, n);
-}
-
-static char *xstrdup(const char *s)
-{
-    char    *p;
-    size_t   n;
-
-    n = xstrlen(s);
-    if (n == 0)
-        return NULL;
-    p = xmalloc(n);
-    return memcpy(p, s, n);
-}
-
-static wchar_t *xwcschr(const wchar_t *src, const wchar_t *exc, wchar_t c)
-{
-    const wchar_t *e;
-    const wchar_t *s = src;
-    while (*s) {
-        if (exc) {
-            for (e = exc; *e; e++) {
-                if (*e == c)
-                    return NULL;
-            }
-        }
-        if (*s == c)
-            return (wchar_t *)s;
-        s++;
-    }
-    return NULL;
-}
-
-static char *xstrchr(const char *src, const char *exc, int c)
-{
-    const char *e;
-    const char *s = src;
-    while (*s) {
-        if (exc) {
-            for (e = exc; *e; e++) {
-                if (*e == c)
-                    return NULL;
-            }
-        }
-        if (*s == c)
-            return (char *)s;
-        s++;
-    }
-    return NULL;
-}
-
-static size_t xstrchrn(const char *str, char ch)
-{
-    const char *s = str;
-    while (*s) {
-        if (*s == ch)
-            return (size_t)(s - str);
-        s++;
-    }
-    return 0;
-}
-
-static wchar_t *xmbstowcs(const char *mbs)
-{
-    wchar_t *wcs;
-    int      mbl;
-
-    mbl = (int)xstrlen(mbs);
-    if (mbl < 1)
-        return NULL;
-    wcs = xwalloc(mbl);
-    if (MultiByteToWideChar(CP_UTF8, 0, mbs, mbl, wcs, mbl + 1) == 0) {
-        xmfree(wcs);
-        wcs = NULL;
-    }
-    return wcs;
-}
-
-static char *xwcstombs(const wchar_t *wcs)
-{
-    char    *mbs;
-    int      wcl;
-    int      mbl;
-
-    wcl = (int)xwcslen(wcs);
-    if (wcl < 1)
-        return NULL;
-    mbl = (wcl * 3);
-    mbs = xmalloc(mbl);
-    if (WideCharToMultiByte(CP_UTF8, 0, wcs, wcl, mbs, mbl + 1, NULL, NULL) == 0) {
-        xmfree(mbs);
-        mbs = NULL;
-    }
-    return mbs;
-}
-
-static wchar_t *xwcsconcat(const wchar_t *s1, const wchar_t *s2, wchar_t qc)
-{
-    wchar_t *rp;
-    wchar_t *rs;
-    size_t   l1;
-    size_t   l2;
-    size_t   sz;
-
-    l1 = xwcslen(s1);
-    l2 = xwcslen(s2);
-
-    sz = l1 + l2;
-    if (sz == 0)
-        return NULL;
-    if (qc)
-       sz += 2;
-    rs = xwalloc(sz);
-    rp = rs;
-    if (qc && !l2)
-        *(rp++) = qc;
-    if (l1 > 0) {
-        wmemcpy(rp, s1, l1);
-        rp += l1;
-    }
-    if (l2 > 0) {
-        if (qc)
-            *(rp++) = qc;
-        wmemcpy(rp, s2, l2);
-        rp += l2;
-    }
-    if (qc) {
-        *(rp++) = qc;
-        *(rp++) = 0;
-    }
-    return rs;
-}
-
-static wchar_t *xwcsappend(wchar_t *s, const wchar_t *a, wchar_t sc)
-{
-    wchar_t *p;
-    wchar_t *e;
-    size_t   n = xwcslen(s);
-    size_t   z = xwcslen(a);
-
-    p = xwalloc(n + z + 1);
-    e = p;
-
-    if (n > 0) {
-        wmemcpy(e, s, n);
-        e += n;
-    }
-    if (z > 0) {
-        if (n && sc)
-            *(e++) = sc;
-        wmemcpy(e, a, z);
-        e += z;
-    }
-    *e = 0;
-    xmfree(s);
-    return p;
-}
-
-static char *xstrappend(char *s, const char *a, char sc)
-{
-    char   *p;
-    char   *e;
-    size_t  n = xstrlen(s);
-    size_t  z = xstrlen(a);
-
-    if (z == 0)
-        return s;
-    p = xmalloc(n + z + 1);
-    e = p;
-
-    if (n > 0) {
-        memcpy(e, s, n);
-        e += n;
-    }
-    if (z > 0) {
-        if (n && sc)
-            *(e++) = sc;
-        memcpy(e, a, z);
-        e += z;
-    }
-    *e = 0;
-    xmfree(s);
-    return p;
-}
-
-/**
- * Remove trailing spaces and return a pointer
- * to the first non white space character
- */
-static wchar_t *xwcstrim(wchar_t *s)
-{
-    size_t i = xwcslen(s);
-
-    while (i > 0) {
-        i--;
-        if (xisnonchar(s[i]))
-            s[i] = 0;
-        else
-            break;
-    }
-    if (i > 0) {
-        while (xisnonchar(*s))
-            s++;
-    }
-    return s;
-}
-
-static char *xstrtrim(char *s)
-{
-    size_t i = xstrlen(s);
-
-    while (i > 0) {
-        i--;
-        if (xisnonchar(s[i]))
-            s[i] = 0;
-        else
-            break;
-    }
-    if (i > 0) {
-        while (xisnonchar(*s))
-            s++;
-    }
-    return s;
-}
-
-char *xstrbegins(int ic, const char *src, const char *str)
-{
-    const char *pos = src;
-    int sa;
-    int sb;
-
-    while (*src) {
-        if (*str == 0)
-            return (char *)pos;
-        if (ic) {
-            sa = xtolower(*src++);
-            sb = xtolower(*str++);
-        }
-        else {
-            sa = *src++;
-            sb = *str++;
-        }
-        if (sa != sb)
-            return NULL;
-        pos++;
-    }
-    return *str ? NULL : (char *)pos;
-}
-
-char *xstrnbegins(int ic, const char *src, const char *str, size_t len)
-{
-    const char *pos = src;
-    int sa;
-    int sb;
-
-    while (*src) {
-        if (*str == 0  || len == 0)
-            return (char *)pos;
-        if (ic) {
-            sa = xtolower(*src++);
-            sb = xtolower(*str++);
-        }
-        else {
-            sa = *src++;
-            sb = *str++;
-        }
-        if (sa != sb)
-            return NULL;
-        pos++;
-        len--;
-    }
-    return len ? NULL : (char *)pos;
-}
-
-static int xstrnicmp(const char *s1, const char *s2, size_t n)
-{
-    int sa;
-    int sb;
-
-    if (n == 0)
-        return 0;
-    do {
-        sa = xtoupper(*s1);
-        sb = xtoupper(*s2);
-        if (sa != sb)
-            return (sa - sb);
-        if (sa == 0)
-            break;
-        s1++;
-        s2++;
-    } while (--n != 0);
-    return 0;
-}
-
-static int xwcsbegins(const wchar_t *src, const wchar_t *str)
-{
-    while (*src) {
-        if (*str == 0)
-            return 1;
-        if (*src++ != *str++)
-            return 0;
-    }
-    return (*str == 0);
-}
-
-static int xwcsequals(const wchar_t *src, const wchar_t *str, wchar_t ech)
-{
-    while (*src) {
-        if (*str == 0)
-            return (*src == 0);
-        if (*src != *str)
-            return 0;
-        src++;
-        str++;
-    }
-    return (*str == ech);
-}
-
-static int xwcsicmp(const wchar_t *s1, const wchar_t *s2)
-{
-    int c1;
-    int c2;
-
-    while ((c1 = xtoupper(*s1++)) == (c2 = xtoupper(*s2++))) {
-        if (c1 == 0)
-            return 0;
-    }
-    return (c1 - c2);
-}
-
-static int xstricmp(const char *s1, const char *s2)
-{
-    int c1;
-    int c2;
-
-    while ((c1 = xtoupper(*s1++)) == (c2 = xtoupper(*s2++))) {
-        if (c1 == 0)
-            return 0;
-    }
-    return (c1 - c2);
-}
-
-/**
- * Match string to expression.
- * Match = 0, NoMatch = 1, Abort = -1
- * Based loosely on sections of wildmat.c by Rich Salz
- *
- * '*' matches any char
- * '@' character must be alphabetic
- * '+' character must be not be control or space
- */
-static int xwcsimatch(const wchar_t *wstr, const wchar_t *wexp)
-{
-    for ( ; *wexp != 0; wstr++, wexp++) {
-        if (*wstr == 0 && *wexp != L'*')
-            return -1;
-        switch (*wexp) {
-            case L'*':
-                wexp++;
-                while (*wexp == L'*')
-                    wexp++;
-                if (*wexp == 0)
-                    return 0;
-                while (*wstr != 0) {
-                    int m = xwcsimatch(wstr++, wexp);
-                    if (m != 1)
-                        return m;
-                }
-                return -1;
-            break;
-            case L'@':
-                if (!xisalpha(*wstr))
-                    return -1;
-            break;
-            case L'+':
-                if (xisnonchar(*wstr))
-                    return -1;
-            break;
-            default:
-                if (xtoupper(*wexp) != xtoupper(*wstr))
-                    return 1;
-            break;
-        }
-    }
-    return (*wstr != 0);
-}
-
-static int xstrimatch(const char *str, const char *exp)
-{
-    for ( ; *exp; str++, exp++) {
-        if (*str == 0 && *exp != '*')
-            return -1;
-        switch (*exp) {
-            case '*':
-                exp++;
-                while (*exp == '*')
-                    exp++;
-                if (*exp == 0)
-                    return 0;
-                while (*str) {
-                    int m = xstrimatch(str++, exp);
-                    if (m != 1)
-                        return m;
-                }
-                return -1;
-            break;
-            case '@':
-                if (!xisalpha(*str))
-                    return -1;
-            break;
-            case '+':
-                if (xisnonchar(*str))
-                    return -1;
-            break;
-            default:
-                if (xtoupper(*exp) != xtoupper(*str))
-                    return 1;
-            break;
-        }
-    }
-    return (*str != 0);
-}
-
-/**
- * Count the number of tokens delimited by d
- */
-static int xwcsntok(const wchar_t *s, wchar_t d)
-{
-    int n = 1;
-
-    while (*s == d) {
-        s++;
-    }
-    if (*s == 0)
-        return 0;
-    while (*s != 0) {
-        if (*(s++) == d) {
-            while (*s == d) {
-                s++;
-            }
-            if (*s != 0)
-                n++;
-        }
-    }
-    return n;
-}
-
-/**
- * This is wcstok_s clone using single character as token delimiter
- */
-static wchar_t *xwcsctok(wchar_t *s, wchar_t d, wchar_t **c)
-{
-    wchar_t *p;
-
-    if ((s == NULL) && ((s = *c) == NULL))
-        return NULL;
-
-    *c = NULL;
-    /**
-     * Skip leading delimiter
-     */
-    while (*s == d) {
-        s++;
-    }
-    if (*s == 0)
-        return NULL;
-    p = s;
-
-    while (*s != 0) {
-        if (*s == d) {
-            *s = 0;
-            *c = s + 1;
-            break;
-        }
-        s++;
-    }
-    return p;
-}
-
-static int xstrntok(const char *s, char d)
-{
-    int n = 1;
-
-    while (*s == d) {
-        s++;
-    }
-    if (*s == 0)
-        return 0;
-    while (*s != 0) {
-        if (*(s++) == d) {
-            while (*s == d) {
-                s++;
-            }
-            if (*s != 0)
-                n++;
-        }
-    }
-    return n;
-}
-
-/**
- * This is strtok_s clone using single character as token delimiter
- */
-static char *xstrctok(char *s, char d, char **c)
-{
-    char *p;
-
-    if ((s == NULL) && ((s = *c) == NULL))
-        return NULL;
-
-    *c = NULL;
-    /**
-     * Skip leading delimiter
-     */
-    while (*s == d) {
-        s++;
-    }
-    if (*s == 0)
-        return NULL;
-    p = s;
-
-    while (*s != 0) {
-        if (*s == d) {
-            *s = 0;
-            *c = s + 1;
-            break;
-        }
-        s++;
-    }
-    return p;
-}
-
-static int xneedsquote(const wchar_t *s)
-{
-    if (s && *s) {
-        while (*s) {
-            if (xisspace(*s) || (*s == 0x22))
-                return 1;
-            s++;
-        }
-    }
-    return 0;
-}
-
-static wchar_t *xwcsquote(wchar_t *s)
-{
-    size_t   n;
-    wchar_t *d;
-    wchar_t *e;
-
-    if (!xneedsquote(s))
-        return s;
-    n = xwcslen(s);
-    e = xwalloc(n + 2);
-    d = e;
-    *(d++) = L'"';
-    wmemcpy(d, s, n);
-    d += n;
-    xmfree(s);
-    *(d++) = L'"';
-    *(d)   = 0;
-
-    return e;
-}
-
-/**
- * Quote one command line argument if needed. See documentation for
- * CommandLineToArgV() for details:
- * https://learn.microsoft.com/en-us/windows/win32/api/shellapi/nf-shellapi-commandlinetoargvw
+ * Use -s and -u command options
  */
-static wchar_t *xquotearg(wchar_t *s)
-{
-    size_t   n = 0;
-    wchar_t *c;
-    wchar_t *e;
-    wchar_t *d;
-
-    /* Perform quoting only if necessary. */
-    if (!xneedsquote(s))
-        return s;
-    for (c = s; ; c++) {
-        size_t b = 0;
-
-        while (*c == L'\\') {
-            b++;
-            c++;
-        }
-
-        if (*c == 0) {
-            n += b * 2;
-            break;
-        }
-        else if (*c == L'"') {
-            n += b * 2 + 1;
-            n += 1;
-        }
-        else {
-            n += b;
-            n += 1;
-        }
-    }
-    n += 2;
-    e = xwalloc(n);
-    d = e;
-
-    *(d++) = L'"';
-    for (c = s; ; c++) {
-        size_t b = 0;
-
-        while (*c == '\\') {
-            b++;
-            c++;
-        }
-
-        if (*c == 0) {
-            wmemset(d, L'\\', b * 2);
-            d += b * 2;
-            break;
-        }
-        else if (*c == L'"') {
-            wmemset(d, L'\\', b * 2 + 1);
-            d += b * 2 + 1;
-            *(d++) = *c;
-        }
-        else {
-            wmemset(d, L'\\', b);
-            d += b;
-            *(d++) = *c;
-        }
-    }
-    xmfree(s);
-    *(d++) = L'"';
-    *(d)   = 0;
-
-    return e;
-}
-
-static int iswinpath(const wchar_t *s)
-{
-    int i = 0;
-
-    if (IS_PSW(s[0])) {
-        if (IS_PSW(s[1]) && (s[2] != 0)) {
-            i  = 2;
-            s += 2;
-            if ((s[0] == L'?' ) &&
-                (IS_PSW(s[1]) ) &&
-                (s[2] != 0)) {
-                /**
-                 * We have \\?\* path
-                 */
-                i += 2;
-                s += 2;
-            }
-        }
-    }
-    if (xisalpha(s[0])) {
-        if (s[1] == L':') {
-            if (s[2] == 0)
-                i += 2;
-            else if (IS_PSW(s[2]))
-                i += 3;
-            else
-                i  = 0;
-        }
-    }
-    return i;
-}
-
-static int isdotpath(const wchar_t *s)
-{
-
-    if (s[0] == L'.') {
-        if (IS_PSW(s[1]))
-            return 300;
-        if ((s[1] == L'.') && IS_PSW(s[2]))
-            return 300;
-    }
-    return 0;
-}
-
-static int ispathlist(const wchar_t *str)
-{
-    const wchar_t *s = str;
-    int   ccolon     = 1;
-    int   pathss     = 0;
-    int   hcolon     = 0;
-
-    if ((*s == L';') || (*s == L':'))
-        return *s;
-    /**
-     * Check if the first elem is windows path
-     */
-    if ((*s == L'\\') || iswinpath(s))
-        ccolon = 0;
-    while (*s) {
-        if (*s ==  L';')
-            return L';';
-        if (*s ==  L'/')
-            pathss = 1;
-        if (pathss && ccolon && (*s == L':'))
-            hcolon = L':';
-
-        s++;
-    }
-    return hcolon;
-}
-
-static int isposixpath(const wchar_t *str)
-{
-    int i = 0;
-
-    if (str[0] != L'/')
-        return isdotpath(str);
-    if (str[1] == 0)
-        return 301;
-    if (str[1] == L'/')
-        return iswinpath(str);
-    if (xwcschr(str + 1, L":;", L'/')) {
-        if (xwcsbegins(str, L"/cygdrive/") &&
-            xisalpha(str[10]) && (str[11] == L'/') && !xisnonchar(str[12]))
-            return 100;
-        while (rootpaths[i] != NULL) {
-            if (xwcsbegins(str, rootpaths[i]))
-                return i + 101;
-            i++;
-        }
-    }
-    else {
-        while (rootpaths[i] != NULL) {
-            if (xwcsequals(str, rootpaths[i], L'/'))
-                return i + 200;
-            i++;
-        }
-    }
-    return 0;
-}
-
-static int isanypath(int m, wchar_t *s)
-{
-    int r;
-    if (IS_EMPTY_WCS(s) || (*s == L'\''))
-        return 0;
-    if (m) {
-        r = ispathlist(s);
-        if (r)
-            return r;
-    }
-    switch (*s) {
-        case L'/':
-            r = isposixpath(s);
-        break;
-        case L'.':
-            r = isdotpath(s);
-        break;
-        default:
-            r = iswinpath(s);
-        break;
-    }
-    return r;
-}
-
-static int xmszcount(const wchar_t *src)
-{
-    int c;
-    const wchar_t *s = src;
+#define CYGWRUN_HAVE_CMDOPTS        0
 
-    if (IS_EMPTY_WCS(src))
-        return 0;
-    for (c = 0; *s; s++, c++) {
-        while (*s)
-            s++;
-    }
-    return c;
-}
+#define CYGWRUN_KILL_DEPTH          4
+#define CYGWRUN_KILL_SIZE         256
+#define CYGWRUN_KILL_TIMEOUT      500
+#define CYGWRUN_CRTL_C_WAIT      2000
+#define CYGWRUN_CRTL_S_WAIT      3000
+#define CYGWRUN_SRV_TIMEOUT      5000
+#define CYGWRUN_SRV_BUFSIZE     65536
+#define CYGWRUN_SRV_SIDSIZE        64   /** TOKEN_USER buffer in DWORDs */
+#define CYGWRUN_TEXTFILE_MAX   0x7FFFFFFF
 
-static wchar_t *warraytomsz(int cnt, const wchar_t **arr, wchar_t sep)
-{
-    int      i;
-    size_t   n;
-    size_t   len = 0;
-    size_t  *sz;
-    wchar_t *ep;
-    wchar_t *bp;
-
-    sz = (size_t *)xcalloc(cnt, sizeof(size_t));
-    for (i = 0; i < cnt; i++) {
-        n = xwcslen(arr[i]);
-        sz[i] = n++;
-        len  += n;
-    }
+#define CYGWRUN_SIGINT          (CYGWRUN_SIGBASE +  2)
+#define CYGWRUN_SIGTERM         (CYGWRUN_SIGBASE + 15)
 
-    bp = xwalloc(len + 2);
-    ep = bp;
-    for (i = 0; i < cnt; i++) {
-        if (i > 0)
-            *(ep++) = sep;
-        wmemcpy(ep, arr[i], sz[i]);
-        ep += sz[i];
-    }
-    xmfree(sz);
-    ep[0] = 0;
-    ep[1] = 0;
+static HANDLE      conevent     = NULL;
+static HANDLE      cprocess     = NULL;
+static int         xenvcount    = 0;
+static wchar_t    *posixpath    = NULL;
 
-    return bp;
-}
+static wchar_t   **xenvvars     = NULL;
+static wchar_t   **xenvvals     = NULL;
+static xpatset    *askipenv     = NULL;
+static xpatset    *adelenvv     = NULL;
 
-static int sortenvvars(const void *a1, const void *a2)
-{
-    const wchar_t *s1 = *((wchar_t **)a1);
-    const wchar_t *s2 = *((wchar_t **)a2);
+static const char **systemenvn = NULL;
+static int         systemenvc   = 0;
 
-    return xwcsicmp(s1, s2);
-}
+static wchar_t   **rspfiles     = NULL;
+static int         rspcount     = 0;
 
-static wchar_t *getenvblock(void)
-{
-    int      c;
-    size_t   n;
-    size_t   v;
-    size_t   z;
-    wchar_t  *bp;
-    wchar_t  *eb;
-    wchar_t **ea;
-    const wchar_t **ep;
-    const wchar_t **ev;
-
-    ep = xenvvars;
-    ev = xenvvals;
-    z  = 0;
-    c  = 0;
-    while (*ep) {
-        n = xwcslen(*ep);
-        if (n) {
-            v = xwcslen(*ev);
-            z = z + v + n + 2;
-            c++;
-        }
-        ep++;
-        ev++;
-    }
-    if (c == 0)
-        return NULL;
-    ea = xwaalloc(c + 1);
-    eb = xwalloc(z + 1);
-    ep = xenvvars;
-    ev = xenvvals;
-    z  = 0;
-    c  = 0;
-    while (*ep) {
-        n = xwcslen(*ep);
-        v = xwcslen(*ev);
-        if (n && v) {
-            ea[c] = eb + z;
-            wmemcpy(eb + z, *ep, ++n);
-            z += n;
-            wmemcpy(eb + z, *ev, ++v);
-            z += v;
-            c++;
-        }
-        ep++;
-        ev++;
-    }
-    eb[z++] = 0;
-    eb[z++] = 0;
-    qsort((void *)ea, c, sizeof(wchar_t *), sortenvvars);
-    bp = eb;
-    for (bp = eb; *bp; bp++) {
-        while (*bp)
-            bp++;
-        *(bp++) = L'=';
-        while (*bp)
-            bp++;
-    }
-    bp = warraytomsz(c, ea, 0);
-    xmfree(eb);
-    xmfree(ea);
+static xtrace      tracer;
+static unsigned long long tracebeg = 0;
 
-    return bp;
-}
+#if CYGWRUN_HAVE_CMDOPTS
+static const char *scmdopt      = NULL;
+static const char *ucmdopt      = NULL;
+#endif
 
 /**
- * If argument starts with '[--]name=' the
- * function will return the string after '='.
+ * Configuration and unset variable names
+ * are defined inside cygwenv.lst
  */
-static wchar_t *cmdoptionval(wchar_t *s)
-{
-    int n = 0;
-
-    if (IS_EMPTY_WCS(s))
-        return NULL;
-    while (*s != 0) {
-        wchar_t c = *(s++);
-        if (n > 0) {
-            if (c == L'=')
-                return s;
-        }
-        if (xisvarchar(c))
-            n++;
-        else
-            break;
-    }
-    return NULL;
-}
+static const char *configvals[CYGWRUN_CONFIG_MAX] = { NULL };
+
+static const wchar_t *sskipenv[] = {
+    L"COMPUTERNAME",
+    L"HOMEDRIVE",
+    L"HOMEPATH",
+    L"HOST",
+    L"HOSTNAME",
+    L"LOGONSERVER",
+    L"PATH",
+    L"PATHEXT",
+    L"PROCESSOR_@*",
+    L"PROMPT",
+    L"USER",
+    L"USERNAME",
+    NULL
+};
 
-static wchar_t *wcleanpath(wchar_t *s)
+static wchar_t *xmbstowcs(const char *mbs)
 {
-    int n = 0;
-    int c;
-    int i;
-
-
-    i = (int)xwcslen(s);
-    if (i == 0)
-        return s;
-    if (i > 6) {
-        if (IS_PSW(s[0]) && IS_PSW(s[1]) && (s[2] == L'?') &&
-            IS_PSW(s[3]) && (s[5] == L':')) {
-            s[0] = L'\\';
-            s[1] = L'\\';
-            s[3] = L'\\';
-            s[4] = (wchar_t)xtoupper(s[4]);
-            s[6] = L'\\';
-            n    = 7;
-        }
-    }
-    if ((n == 0) && (i > 2)) {
-        if (xisalpha(s[0]) && (s[1] == L':') && IS_PSW(s[2])) {
-            s[0] = (wchar_t)xtoupper(s[0]);
-            s[2] = L'\\';
-            n    = 3;
-        }
-    }
-    for (c = n; n < i; n++) {
-        if (c > 0) {
-            if (IS_PSW(s[c - 1]) && (s[n] == L'.') && IS_PSW(s[n + 1])) {
-                n++;
-                while (IS_PSW(s[n]))
-                    n++;
-            }
-        }
-        if (IS_PSW(s[n]))  {
-            if (n > 0) {
-                while (IS_PSW(s[n + 1]))
-                    n++;
-            }
-            s[n] = L'\\';
-        }
-        s[c++] = s[n];
-    }
-    s[c--] = 0;
-    while (c > 0) {
-        if ((s[c] == L';') || ((s[c] == xrmendps) && (s[c - 1] != L'.')) || xisnonchar(s[c]))
-            s[c--] = 0;
-        else
-            break;
-    }
-    return s;
-}
+    wchar_t *wcs;
+    size_t   wcl;
 
-static wchar_t **wcstoarray(const wchar_t *s, wchar_t sc)
-{
-    int      c;
-    int      x = 0;
-    wchar_t  *cx = NULL;
-    wchar_t  *ws;
-    wchar_t  *es;
-    wchar_t **sa;
-
-    c =  xwcsntok(s, sc);
-    if (c == 0)
+    wcl = xutf8towcs(NULL, mbs);
+    if (wcl < 1)
         return NULL;
-    ws = xwcsdup(s);
-    sa = xwaalloc(c);
-    es = xwcsctok(ws, sc, &cx);
-    while (es != NULL) {
-        es = xwcstrim(es);
-        if (*es != 0)
-            sa[x++] = xwcsdup(es);
-        es = xwcsctok(NULL, sc, &cx);
-    }
-    xmfree(ws);
-    sa[x] = NULL;
-    if (x == 0) {
-        xafree(sa);
-        sa = NULL;
-    }
-    return sa;
+    wcs = xwalloc(wcl);
+    xutf8towcs(wcs, mbs);
+    return wcs;
 }
 
-static char **strtoarray(const char *s, char sc)
+static char *xwcstombs(const wchar_t *wcs)
 {
-    int      c;
-    int      x = 0;
-    char    *cx = NULL;
-    char    *ws;
-    char    *es;
-    char   **sa;
-
-    if (IS_EMPTY_STR(s))
-        return NULL;
-    c =  xstrntok(s, sc);
-    if (c == 0)
-        return NULL;
-    ws = xstrdup(s);
-    sa = xsaalloc(c);
-    es = xstrctok(ws, sc, &cx);
-    while (es != NULL) {
-        es = xstrtrim(es);
-        if (*es != 0)
-            sa[x++] = xstrdup(es);
-        es = xstrctok(NULL, sc, &cx);
-    }
-    xmfree(ws);
-    sa[x] = NULL;
-    if (x == 0) {
-        xafree(sa);
-        sa = NULL;
-    }
-    return sa;
-}
+    char    *mbs;
+    int      wcl;
+    int      mbl;
 
-static wchar_t **splitpath(const wchar_t *s, wchar_t ps)
-{
-    int      c;
-    int      x = 0;
-    wchar_t  *ws;
-    wchar_t **sa;
-    wchar_t  *cx = NULL;
-    wchar_t  *es;
-
-    c =  xwcsntok(s, ps);
-    if (c == 0)
+    wcl = (int)xwcslen(wcs);
+    if (wcl < 1)
         return NULL;
-    ws = xwcsdup(s);
-    sa = xwaalloc(c);
-
-    es = xwcsctok(ws, ps, &cx);
-    while (es != NULL) {
-        es = xwcstrim(es);
-        if (*es != 0)
-            sa[x++] = xwcsdup(es);
-        es = xwcsctok(NULL, ps, &cx);
-    }
-    xmfree(ws);
-    return sa;
-}
-
-static wchar_t *mergepath(const wchar_t **pp)
-{
-    int  i;
-    int  x;
-    size_t s[64];
-    size_t n;
-    size_t len = 0;
-    wchar_t *r;
-    wchar_t *p;
-
-    for (i = 0, x = 0; pp[i] != NULL; i++, x++) {
-        n = xwcslen(pp[i]);
-        if (x < 64)
-            s[x] = n;
-        len += (n + 1);
-    }
-    r = p = xwalloc(len + 2);
-    for (i = 0, x = 0; pp[i] != NULL; i++, x++) {
-        if (x < 64)
-            n = s[x];
-        else
-            n = xwcslen(pp[i]);
-        if (n) {
-            if (i > 0 && p > r)
-                *(p++) = L';';
-            wmemcpy(p, pp[i], n);
-            p += n;
-        }
-    }
-    *p = 0;
-    return r;
-}
-
-static wchar_t *posixtowin(wchar_t *pp, int m)
-{
-    wchar_t *rp = NULL;
-    wchar_t  windrive[] = { 0, L':', L'\\', 0};
-
-    if (m == 0)
-        m = isposixpath(pp);
-    if (m == 0) {
-        /**
-         * Not a posix path
-         */
-        return pp;
-    }
-    else if (m <  100) {
-        return wcleanpath(pp);
-    }
-    else if (m == 100) {
-        /**
-         * /cygdrive/x/... absolute path
-         */
-        windrive[0] = (wchar_t)xtoupper(pp[10]);
-        rp = xwcsconcat(windrive, pp + 12, 0);
-        wcleanpath(rp + 3);
-    }
-    else if (m == 300) {
-        if (ispathlist(pp) == L':')
-            return pp;
-        else
-            return wcleanpath(pp);
-    }
-    else if (m == 301) {
-        rp = xwcsdup(posixroot);
-    }
-    else {
-        pp = wcleanpath(pp);
-        if (*pp != L'\\')
-            return pp;
-        rp = xwcsconcat(posixroot, pp, 0);
-    }
-    xmfree(pp);
-    return rp;
-}
-
-static wchar_t *pathtowin(wchar_t *pp)
-{
-    int m;
-
-    m = isanypath(0, pp);
-    if (m)
-        return posixtowin(pp, m);
-    else
-        return pp;
-}
-
-static wchar_t *pathstowin(const wchar_t *ps)
-{
-    int i;
-    int m;
-    wchar_t   sc = 0;
-    wchar_t **pa;
-    wchar_t  *wp = NULL;
-
-    sc = (wchar_t)ispathlist(ps);
-    if (sc == 0) {
-        /* Not a path list */
-        wp = xwcsdup(ps);
-        m  = isposixpath(wp);
-        if (m == 0)
-            wp = wcleanpath(wp);
-        else
-            wp = posixtowin(wp, m);
-        return wp;
-    }
-    else if (sc == L';') {
-        pa = splitpath(ps, sc);
-
-        if (pa != NULL) {
-            for (i = 0; pa[i] != NULL; i++) {
-                m = isposixpath(pa[i]);
-                if (m == 0)
-                    pa[i] = wcleanpath(pa[i]);
-                else
-                    pa[i] = posixtowin(pa[i], m);
-            }
-        }
-    }
-    else {
-        pa = splitpath(ps, sc);
-
-        if (pa != NULL) {
-            for (i = 0; pa[i] != NULL; i++) {
-                m = isposixpath(pa[i]);
-                if (m == 0) {
-                    xafree(pa);
-                    return xwcsdup(ps);
-                }
-                else {
-                    pa[i] = posixtowin(pa[i], m);
-                }
-            }
-        }
-    }
-    if (pa != NULL) {
-        wp = mergepath(pa);
-        xafree(pa);
+    mbl = (wcl * 3);
+    mbs = xmalloc(mbl);
+    if (WideCharToMultiByte(CP_UTF8, 0, wcs, wcl, mbs, mbl + 1, NULL, NULL) == 0) {
+        xmfree(mbs);
+        mbs = NULL;
     }
-    if (wp == NULL)
-        wp = xwcsdup(ps);
-    return wp;
+    return mbs;
 }
 
-
 static wchar_t *getrealpathname(const wchar_t *path, int isdir)
 {
     wchar_t    *buf  = NULL;
@@ -1551,15 +167,41 @@ static wchar_t *getrealpathname(const wchar_t *path, int isdir)
     return buf;
 }
 
-static wchar_t *xsearchexe(const wchar_t *name)
+/**
+ * Search the PATH for the file.
+ * Buffer is enlarged if the found path
+ * does not fit, so long paths are not truncated.
+ */
+static wchar_t *xsearchpath(const wchar_t *name, const wchar_t *ext)
 {
     DWORD     n;
-    wchar_t   b[CYGWRUN_PATH_MAX];
+    DWORD     s = MAX_PATH;
+    wchar_t  *b;
+
+    b = xwalloc(s);
+    n = SearchPathW(NULL, name, ext, s, b, NULL);
+    if (n >= s) {
+        xmfree(b);
+        s = n;
+        b = xwalloc(s);
+        n = SearchPathW(NULL, name, ext, s, b, NULL);
+    }
+    if ((n == 0) || (n >= s)) {
+        xmfree(b);
+        return NULL;
+    }
+    return b;
+}
+
+static wchar_t *xsearchexe(const wchar_t *name)
+{
+    wchar_t  *b;
     wchar_t  *r = NULL;
 
-    n = SearchPathW(NULL, name, L".exe", CYGWRUN_PATH_MAX, b, NULL);
-    if ((n > 8) && (n < CYGWRUN_PATH_MAX))
+    b = xsearchpath(name, L".exe");
+    if ((b != NULL) && (xwcslen(b) > 8))
         r = getrealpathname(b, 0);
+    xmfree(b);
     return r;
 }
 
@@ -1671,39 +313,361 @@ static void killproctree(DWORD pid)
 
 static wchar_t *getcygwinroot(void)
 {
-    DWORD    n;
-    wchar_t  b[MAX_PATH];
-    wchar_t *r = NULL;
-
-    n = SearchPathW(NULL, L"cygwin1.dll", NULL, MAX_PATH, b, NULL);
-    if ((n > 20) && (n < MAX_PATH)) {
-        b[n - 16] = 0;
-        r = xwcsdup(b);
-        r = wcleanpath(r);
-    }
-    else {
-        n = MAX_PATH * 2;
+    DWORD    n = 0;
+    wchar_t *r;
+
+    r = xsearchpath(L"cygwin1.dll", NULL);
+    if (r != NULL) {
+        n = (DWORD)xwcslen(r);
+        if (n > 20) {
+            r[n - 16] = 0;
+            return wcleanpath(r);
+        }
+        xmfree(r);
+    }
+    r = NULL;
+    if (RegGetValueW(HKEY_LOCAL_MACHINE,
+                     L"Software\\Cygwin\\setup",
+                     L"rootdir",
+                     RRF_RT_REG_SZ,
+                     NULL,
+                     NULL, &n) == ERROR_SUCCESS) {
+        r = xwalloc(n / sizeof(wchar_t));
         if (RegGetValueW(HKEY_LOCAL_MACHINE,
                          L"Software\\Cygwin\\setup",
                          L"rootdir",
                          RRF_RT_REG_SZ,
                          NULL,
-                         b, &n) == ERROR_SUCCESS) {
-            r = xwcsdup(b);
+                         r, &n) == ERROR_SUCCESS) {
             r = wcleanpath(r);
         }
+        else {
+            xmfree(r);
+            r = NULL;
+        }
+    }
+    return r;
+}
+
+/**
+ * Get the cygwin root from the launch cache.
+ * Root is found by searching the PATH, so the PATH value is used
+ * as the cache key and cygwin1.dll validates the entry.
+ */
+static wchar_t *getlaunchroot(void)
+{
+    wchar_t *k;
+    wchar_t *r;
+
+    k = xwcsconcat(L"root:", xmbstowcs(configvals[CCYGWIN_PATH]), 0);
+    r = xlcget(k);
+    if (r == NULL) {
+        r = getcygwinroot();
+        if (r != NULL) {
+            wchar_t *v = xwcsconcat(r, L"\\bin\\cygwin1.dll", 0);
+
+            xlcput(k, r, v);
+            xmfree(v);
+        }
+    }
+    xmfree(k);
+    return r;
+}
+
+/**
+ * Get the directory of the cygwrun executable
+ */
+static wchar_t *getmoduledir(void)
+{
+    DWORD    n;
+    DWORD    s = MAX_PATH;
+    wchar_t *b;
+    wchar_t *p;
+
+    for (;;) {
+        b = xwalloc(s);
+        n = GetModuleFileNameW(NULL, b, s);
+        if ((n > 0) && (n < s))
+            break;
+        xmfree(b);
+        if (n == 0)
+            return NULL;
+        s *= 2;
+    }
+    p = wcsrchr(b, L'\\');
+    if (p != NULL)
+        *p = 0;
+    return b;
+}
+
+/**
+ * Append the directory d of length n to the list v.
+ * Returns nonzero if d is the directory of length rn
+ * at the start of r, where the search has found r.
+ */
+static int addsearchdir(wchar_t **v, const wchar_t *d, size_t n,
+                        const wchar_t *r, size_t rn)
+{
+    wchar_t *s;
+
+    if ((n > 3) && (d[n - 1] == L'\\'))
+        n--;
+    if ((n == rn) && (xwcsnicmp(d, r, rn) == 0))
+        return 1;
+    s  = xwcsndup(d, n);
+    *v = xwcsappend(*v, s, L';');
+    xmfree(s);
+    return 0;
+}
+
+/**
+ * Get the files that validate the program r found by
+ * SearchPathW with the safe search mode disabled.
+ * Program with the same name added to any directory
+ * searched before the one that contains r changes the
+ * directory time. Those are the cygwrun directory, the
+ * current directory, the system, 16-bit system and
+ * windows directories, and the PATH directories.
+ */
+static wchar_t *getsearchfiles(const wchar_t *r)
+{
+    int            i;
+    int            f = 0;
+    DWORD          n;
+    size_t         dn;
+    const wchar_t *cx = posixpath;
+    xwcsview       t;
+    wchar_t       *v;
+    wchar_t       *d;
+    wchar_t       *sd[5] = { NULL, NULL, NULL, NULL, NULL };
+
+    d  = wcsrchr(r, L'\\');
+    dn = d ? (size_t)(d - r) : 0;
+    sd[0] = getmoduledir();
+    n = GetCurrentDirectoryW(0, NULL);
+    if (n > 0) {
+        sd[1] = xwalloc(n);
+        GetCurrentDirectoryW(n, sd[1]);
+    }
+    n = GetSystemDirectoryW(NULL, 0);
+    if (n > 0) {
+        sd[2] = xwalloc(n);
+        GetSystemDirectoryW(sd[2], n);
+    }
+    n = GetWindowsDirectoryW(NULL, 0);
+    if (n > 0) {
+        sd[4] = xwalloc(n);
+        GetWindowsDirectoryW(sd[4], n);
+        sd[3] = xwcsconcat(sd[4], L"\\System", 0);
+    }
+    v = xwcsdup(r);
+    for (i = 0; i < 5; i++) {
+        if ((f == 0) && (sd[i] != NULL))
+            f = addsearchdir(&v, sd[i], xwcslen(sd[i]), r, dn);
+        xmfree(sd[i]);
+    }
+    while ((f == 0) && xwcsnext(&cx, L';', &t))
+        f = addsearchdir(&v, t.s, t.n, r, dn);
+    return v;
+}
+
+/**
+ * Get the program path from the launch cache.
+ * Relative names depend on the current directory and
+ * the PATH, so both are part of the cache key, and
+ * programs found in PATH are also validated by the
+ * directories searched before them.
+ */
+static wchar_t *getlaunchexe(const wchar_t *name)
+{
+    DWORD    n;
+    wchar_t *k;
+    wchar_t *r;
+
+    k = xwcsdup(L"exe:");
+    if (iswinpath(name) == 0) {
+        n = GetCurrentDirectoryW(0, NULL);
+        if (n > 0) {
+            wchar_t *d = xwalloc(n);
+
+            GetCurrentDirectoryW(n, d);
+            k = xwcsappend(k, d, 0);
+            xmfree(d);
+        }
+        k = xwcsappend(k, L"|", 0);
+        k = xwcsappend(k, posixpath, 0);
+    }
+    k = xwcsappend(k, name, L'|');
+    r = xlcget(k);
+    if (r == NULL) {
+        r = getrealpathname(name, 0);
+        if (r != NULL) {
+            xlcput(k, r, r);
+        }
+        else {
+            SetSearchPathMode(BASE_SEARCH_PATH_DISABLE_SAFE_SEARCHMODE);
+            r = xsearchexe(name);
+            if (r != NULL) {
+                wchar_t *v = getsearchfiles(r);
+
+                xlcput(k, r, v);
+                xmfree(v);
+            }
+        }
+    }
+    xmfree(k);
+    return r;
+}
+
+/**
+ * Read the UTF-8 text file and convert it to wide string.
+ * Returns NULL if the file does not exist or it is too large.
+ */
+static wchar_t *readtextfile(const wchar_t *name)
+{
+    HANDLE        fh;
+    LARGE_INTEGER fs;
+    DWORD         rd = 0;
+    DWORD         sz;
+    char         *b  = NULL;
+    wchar_t      *r  = NULL;
+
+    fh = CreateFileW(name, GENERIC_READ, FILE_SHARE_READ, NULL,
+                     OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (fh == INVALID_HANDLE_VALUE)
+        return NULL;
+    if (GetFileSizeEx(fh, &fs) &&
+        (fs.QuadPart > 0) && (fs.QuadPart < CYGWRUN_TEXTFILE_MAX)) {
+        sz = (DWORD)fs.QuadPart;
+        b  = xmalloc(sz);
+        if (ReadFile(fh, b, sz, &rd, NULL) && (rd > 0)) {
+            b[rd] = '\0';
+            r = xmbstowcs(b);
+        }
+        xmfree(b);
     }
+    CloseHandle(fh);
     return r;
 }
 
+static int getfilemtime(const wchar_t *name, unsigned long long *mt)
+{
+    WIN32_FILE_ATTRIBUTE_DATA ad;
+
+    if (!GetFileAttributesExW(name, GetFileExInfoStandard, &ad))
+        return CYGWRUN_ENOENT;
+    *mt = ((unsigned long long)ad.ftLastWriteTime.dwHighDateTime << 32) |
+           (unsigned long long)ad.ftLastWriteTime.dwLowDateTime;
+    return 0;
+}
+
+static int isdirectory(const wchar_t *name)
+{
+    DWORD fa = GetFileAttributesW(name);
+
+    return (fa != INVALID_FILE_ATTRIBUTES) && (fa & FILE_ATTRIBUTE_DIRECTORY);
+}
+
+/**
+ * Write the file by replacing it with the temporary copy,
+ * so that concurrent launches never read partial content.
+ */
+static int writetextfile(const wchar_t *name, const char *b, size_t n)
+{
+    HANDLE   fh;
+    DWORD    wr = 0;
+    DWORD    id;
+    wchar_t  s[16];
+    wchar_t *t;
+    int      i  = 15;
+    int      rv = CYGWRUN_EBADPATH;
+
+    s[i] = L'\0';
+    id   = GetCurrentProcessId();
+    do {
+        s[--i] = L"0123456789abcdef"[id & 15];
+        id >>= 4;
+    } while (id);
+    t  = xwcsconcat(name, s + i, L'.');
+    fh = CreateFileW(t, GENERIC_WRITE, 0, NULL,
+                     CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (fh == INVALID_HANDLE_VALUE) {
+        xmfree(t);
+        return rv;
+    }
+    if (WriteFile(fh, b, (DWORD)n, &wr, NULL) && (wr == (DWORD)n))
+        rv = 0;
+    CloseHandle(fh);
+    if ((rv == 0) && !MoveFileExW(t, name, MOVEFILE_REPLACE_EXISTING))
+        rv = CYGWRUN_EBADPATH;
+    if (rv)
+        DeleteFileW(t);
+    xmfree(t);
+    return rv;
+}
+
+static const xfsops winfsops = {
+    getfilemtime,
+    readtextfile,
+    writetextfile
+};
+
+static unsigned long long gettick(void)
+{
+    LARGE_INTEGER c;
+
+    QueryPerformanceCounter(&c);
+    return (unsigned long long)c.QuadPart;
+}
+
+static void tracebegin(void)
+{
+    tracebeg = gettick();
+}
+
+static void traceend(int phase)
+{
+    tracer.tick[phase] += gettick() - tracebeg;
+}
+
+/**
+ * Append the trace record to the CYGWRUN_TRACE file.
+ * Record is written with a single append, so that
+ * concurrent invocations do not mix their lines.
+ */
+static void writetrace(int rc)
+{
+    HANDLE   h;
+    DWORD    n;
+    LARGE_INTEGER f;
+    wchar_t *tf;
+    char     b[CYGWRUN_TRACE_LINE];
+
+    if (configvals[CYGWRUN_TRACE] == NULL)
+        return;
+    QueryPerformanceFrequency(&f);
+    tracer.tick[XTRACE_TOTAL] = gettick() - tracer.tick[XTRACE_TOTAL];
+    tracer.freq = (unsigned long long)f.QuadPart;
+    tracer.pid  = GetCurrentProcessId();
+    tracer.rc   = rc;
+    n  = (DWORD)xtraceline(b, &tracer);
+    tf = pathtowin(xmbstowcs(configvals[CYGWRUN_TRACE]));
+    h  = CreateFileW(tf, FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                     NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    xmfree(tf);
+    if (h == INVALID_HANDLE_VALUE)
+        return;
+    WriteFile(h, b, n, &n, NULL);
+    CloseHandle(h);
+}
+
 static int initenvironment(const char **envp)
 {
     const char **a;
     const char *ep;
     const char *ev;
-    char  *ed;
     size_t n = 0;
-    int    i;
+    const xenvname *xe;
 
     a = envp;
     while (*a != NULL) {
@@ -1711,8 +675,7 @@ static int initenvironment(const char **envp)
         a++;
     }
     systemenvc = 0;
-    systemenvn = xsaalloc(n + 1);
-    systemenvv = xsaalloc(n + 1);
+    systemenvn = (const char **)xsaalloc(n + 1);
 
     while (*envp) {
         ep = *envp;
@@ -1730,69 +693,47 @@ static int initenvironment(const char **envp)
         ev = ep + n + 1;
         if (IS_EMPTY_STR(ev))
             return CYGWRUN_EEMPTY;
-        for (i = 0; unsetvars[i]; i++) {
-            if (xstrnicmp(ep, unsetvars[i], n) == 0) {
-                ev = NULL;
-                break;
-            }
-        }
-        if (ev == NULL) {
-            envp++;
-            continue;
-        }
-        for (i = 0; configvars[i]; i++) {
-            if (xstrnicmp(ep, configvars[i], n) == 0) {
-                if (configvals[i]) {
+        xe = xenvlookup(ep, n);
+        if (xe != NULL) {
+            if (xe->type == XENV_CONFIG) {
+                if (configvals[xe->index]) {
                     /* Multiple variables */
                     return CYGWRUN_EALREADY;
                 }
-                else {
-                    configvals[i] = ev;
-                    ev = NULL;
-                    break;
-                }
+                configvals[xe->index] = ev;
             }
-        }
-        if (ev == NULL) {
             envp++;
             continue;
         }
-        ed    = xstrdup(ep);
-        ed[n] = '\0';
-        systemenvn[systemenvc] = ed;
-        systemenvv[systemenvc] = ed + n + 1;
-        systemenvc++;
+        systemenvn[systemenvc++] = ep;
         envp++;
     }
     return 0;
 }
 
-static int setupenvironment(void)
+/**
+ * Setup environment from the converted
+ * NAME=VALUE strings inside the slab
+ */
+static int setupenvironment(wchar_t **wenv)
 {
     int i;
-    int j;
 
     xenvcount = 0;
     xenvvars  = xwaalloc(systemenvc + 3);
     xenvvals  = xwaalloc(systemenvc + 3);
     for (i = 0; i < systemenvc; i++) {
-        char *es = systemenvn[i];
+        wchar_t *es = wenv[i];
+        wchar_t *ev = xwcsscan(es, XSCAN_CHR, L'=');
 
-        if (adelenvv) {
-            for (j = 0; adelenvv[j]; j++) {
-                if (xstrimatch(es, adelenvv[j]) == 0) {
-                    xmfree(es);
-                    es = NULL;
-                    break;
-                }
-            }
-        }
-        if (es == NULL)
+        if (*ev == 0)
+            return CYGWRUN_EBADENV;
+        *(ev++) = 0;
+        if (xpatmatch(adelenvv, es) >= 0)
             continue;
-        xenvvars[xenvcount] = xmbstowcs(es);
-        xenvvals[xenvcount] = xmbstowcs(systemenvv[i]);
+        xenvvars[xenvcount] = es;
+        xenvvals[xenvcount] = ev;
         xenvcount++;
-        xmfree(es);
     }
     xenvvars[xenvcount] = xwcsdup(L"PATH");
     xenvvals[xenvcount] = posixpath;
@@ -1804,131 +745,202 @@ static int setupenvironment(void)
     xenvvals[xenvcount] = xmbstowcs(configvals[CCYGWIN_TMP]);
     xenvcount++;
     xmfree(systemenvn);
-    xmfree(systemenvv);
     return 0;
 }
 
-static int runprogram(int argc, wchar_t **argv)
+static void compilepatterns(void)
 {
-    int      i;
-    int      m;
-    size_t   n;
-    DWORD    rc = 0;
-    wchar_t *cmdblk = NULL;
-    wchar_t *envblk = NULL;
-    wchar_t *cmdexe = NULL;
+    char    *sparam;
+    wchar_t *wparam;
 
-    PROCESS_INFORMATION cp;
-    STARTUPINFOW si;
+    sparam   = xstrdup(configvals[CYGWRUN_SKIP]);
+#if CYGWRUN_HAVE_CMDOPTS
+    sparam   = xstrappend(sparam, scmdopt,  ',');
+#endif
+    wparam   = xmbstowcs(sparam);
+    askipenv = xpatcompile(sskipenv, wparam, L',');
+#if CYGWRUN_USE_MEMFREE
+    xmfree(wparam);
+    xmfree(sparam);
+#endif
+    sparam   = xstrdup(configvals[CYGWRUN_UNSET]);
+#if CYGWRUN_HAVE_CMDOPTS
+    sparam   = xstrappend(sparam, ucmdopt,  ',');
+#endif
+    wparam   = xmbstowcs(sparam);
+    adelenvv = xpatcompile(NULL, wparam, L',');
+#if CYGWRUN_USE_MEMFREE
+    xmfree(wparam);
+    xmfree(sparam);
+#endif
+}
 
-    for (i = 1; i < argc; i++) {
-        wchar_t *v;
-        wchar_t *a = argv[i];
+static int initpath(void)
+{
+    wchar_t *eparam;
 
-        if (*a == L'\'') {
-            if (argv[0] != zerowcs)
-                continue;
-            n = xwcslen(a);
-            if (a[n - 1] == L'\'') {
-                v = xwalloc(n - 2);
-                wmemcpy(v, a + 1, n - 2);
-                xmfree(a);
-                argv[i] = v;
-            }
+    eparam = xmbstowcs(configvals[CYGWRUN_PATH]);
+    if (eparam == NULL)
+        eparam = xmbstowcs(configvals[CCYGWIN_PATH]);
+    if (eparam == NULL)
+        return CYGWRUN_ENOENT;
+    posixpath = pathstowin(eparam);
+    if (posixpath == NULL)
+        return CYGWRUN_EBADPATH;
+    if (configvals[CYGWRUN_PRUNE]) {
+        wchar_t *pp = prunepath(posixpath, isdirectory);
+
+        if (!IS_EMPTY_WCS(pp)) {
+            xmfree(posixpath);
+            posixpath = pp;
+        }
+    }
+#if CYGWRUN_USE_MEMFREE
+    xmfree(eparam);
+#endif
+    SetEnvironmentVariableW(L"PATH", posixpath);
+    return 0;
+}
+
+/**
+ * Translate the values of environment variables
+ * that are not in the skip list
+ */
+static void translateenv(void)
+{
+    int i;
+
+    for (i = 0; i < xenvcount; i++) {
+        wchar_t *v = xenvvals[i];
+
+        if (xenvvars[i] == zerowcs)
+            continue;
+        tracer.envseen++;
+        if (xpatmatch(askipenv, xenvvars[i]) >= 0) {
+            tracer.envskip++;
             continue;
         }
-        v = cmdoptionval(a);
+        v = anypathtowin(v);
         if (v != NULL) {
-            /**
-             * In case the argv is [-|--]argument=["]value["]
-             * evaluate the value as environment variable.
-             */
-            wchar_t  qc = 0;
-            wchar_t *qp = NULL;
-            if (v[0] == L'"') {
-                /* We have quoted value */
-                n = xwcslen(v) - 1;
-                if ((n > 1) && (v[n] == v[0])) {
-                    qc = v[0];
-                    qp = v + n;
-                    *(qp)  = 0;
-                    *(v++) = 0;
-                }
-                else {
-                    /**
-                     * Found unterminated quote
-                     * eg. -a="b
-                     * Skip argument
-                     */
-                    continue;
-                }
-            }
-            m = isanypath(1, v);
-            if (m != 0) {
-                wchar_t *p = pathstowin(v);
-                if (qp == NULL)
-                    v[0] = 0;
-                argv[i]  = xwcsconcat(a, p, qc);
-                xmfree(a);
-                xmfree(p);
-            }
-            else {
-                if (qp != NULL) {
-                    *qp = qc;
-                    *(--v) = qc;
-                }
-            }
-        }
-        else {
-            argv[i] = pathtowin(a);
+            xmfree(xenvvals[i]);
+            xenvvals[i] = v;
+            tracer.envxlat++;
         }
     }
-    if (argv[0] == zerowcs) {
-        for (i = 1; i < argc; i++) {
-            char *u = xwcstombs(argv[i]);
-            if (i > 1)
-                fputc('\n', stdout);
-            fputs(u, stdout);
-            xmfree(u);
-        }
-        return 0;
+}
+
+/**
+ * Create and open the temporary response file.
+ * The file name is stored in tf.
+ */
+static FILE *newrspfile(wchar_t *tf)
+{
+    FILE    *fo;
+    wchar_t  tp[MAX_PATH];
+
+    if ((GetTempPathW(MAX_PATH, tp) == 0) ||
+        (GetTempFileNameW(tp, L"cyg", 0, tf) == 0))
+        return NULL;
+    fo = _wfopen(tf, L"wb");
+    if (fo == NULL)
+        DeleteFileW(tf);
+    return fo;
+}
+
+/**
+ * Close the temporary response file and return the @file
+ * argument. The file is deleted after the child process exits,
+ * or immediately if it was not written.
+ */
+static wchar_t *endrspfile(FILE *fo, const wchar_t *tf, int rv)
+{
+    fclose(fo);
+    if (rv) {
+        DeleteFileW(tf);
+        return NULL;
     }
-    for (i = 0; i < xenvcount; i++) {
-        int j;
-        wchar_t *v = xenvvals[i];
+    rspfiles[rspcount++] = xwcsdup(tf);
+    return xwcsconcat(L"@", tf, 0);
+}
+
+/**
+ * Translate the @file response file argument
+ * into the temporary response file.
+ * Returns NULL if the file cannot be translated.
+ */
+static wchar_t *rspfiletowin(const wchar_t *a)
+{
+    FILE    *fi;
+    FILE    *fo;
+    wchar_t *n;
+    wchar_t  tf[MAX_PATH];
+    int      rv;
+
+    n  = pathtowin(xwcsdup(a + 1));
+    fi = _wfopen(n, L"rb");
+    xmfree(n);
+    if (fi == NULL)
+        return NULL;
+    fo = newrspfile(tf);
+    if (fo == NULL) {
+        fclose(fi);
+        return NULL;
+    }
+    rv = xrsptowin(fi, fo);
+    fclose(fi);
+    return endrspfile(fo, tf, rv);
+}
+
+/**
+ * Write the quoted arguments into the temporary response file
+ * when the command line is too long for CreateProcess.
+ * CYGWRUN_RSPFILE set to utf16 selects UTF-16LE encoding.
+ * Returns NULL if the file cannot be written.
+ */
+static wchar_t *spillrspfile(int argc, wchar_t **argv)
+{
+    FILE    *fo;
+    wchar_t  tf[MAX_PATH];
+    int      wide;
+
+    wide = (xstricmp(configvals[CYGWRUN_RSPFILE], "utf16")  == 0) ||
+           (xstricmp(configvals[CYGWRUN_RSPFILE], "utf-16") == 0);
+    fo = newrspfile(tf);
+    if (fo == NULL)
+        return NULL;
+    return endrspfile(fo, tf, xargstorsp(fo, argc, argv, wide));
+}
+
+static void delrspfiles(void)
+{
+    int i;
+
+    for (i = 0; i < rspcount; i++)
+        DeleteFileW(rspfiles[i]);
+    rspcount = 0;
+}
+
+/**
+ * Create the process and wait for it to finish.
+ * Returns the process exit code.
+ */
+static int launchprogram(const wchar_t *exe, wchar_t *cmdblk, wchar_t *envblk)
+{
+    DWORD    rc = 0;
+
+    PROCESS_INFORMATION cp;
+    STARTUPINFOW si;
 
-        if (xenvvars[i] == zerowcs)
-            continue;
-        for (j = 0; askipenv[j]; j++) {
-            if (xwcsimatch(xenvvars[i], askipenv[j]) == 0) {
-                j = -1;
-                break;
-            }
-        }
-        if (j < 0)
-            continue;
-        m = isanypath(1, v);
-        if (m != 0) {
-            xenvvals[i] = pathstowin(v);
-            xmfree(v);
-        }
-    }
     conevent = CreateEventW(NULL, FALSE, FALSE, NULL);
     if (conevent == NULL)
         return CYGWRUN_FAILED;
-    cmdexe  = xwcsdup(argv[0]);
-    argv[0] = xwcsquote(argv[0]);
-    for (i = 1; i < argc; i++)
-        argv[i] = xquotearg(argv[i]);
-    cmdblk = warraytomsz(argc, argv, L' ');
-    envblk = getenvblock();
-
     memset(&cp, 0, sizeof(PROCESS_INFORMATION));
     memset(&si, 0, sizeof(STARTUPINFOW));
     si.cb = (DWORD)sizeof(STARTUPINFOW);
 
     SetConsoleCtrlHandler(NULL, FALSE);
-    if (!CreateProcessW(cmdexe,
+    tracebegin();
+    if (!CreateProcessW(exe,
                         cmdblk,
                         NULL, NULL, TRUE,
                         CREATE_SUSPENDED | CREATE_UNICODE_ENVIRONMENT,
@@ -1936,8 +948,8 @@ static int runprogram(int argc, wchar_t **argv)
                        &si, &cp)) {
         rc = CYGWRUN_FAILED;
     }
+    traceend(XTRACE_CREATE);
 #if CYGWRUN_USE_MEMFREE
-    xmfree(cmdexe);
     xmfree(envblk);
     xmfree(cmdblk);
 #endif
@@ -1945,6 +957,7 @@ static int runprogram(int argc, wchar_t **argv)
         HANDLE wh[2];
         DWORD  ws;
 
+        tracebegin();
         cprocess = cp.hProcess;
         SetConsoleCtrlHandler(consolehandler, TRUE);
         ResumeThread(cp.hThread);
@@ -1980,11 +993,98 @@ static int runprogram(int argc, wchar_t **argv)
         }
         SetConsoleCtrlHandler(consolehandler, FALSE);
         CloseHandle(cprocess);
+        traceend(XTRACE_WAIT);
     }
     CloseHandle(conevent);
     return rc;
 }
 
+static int runprogram(int argc, wchar_t **argv)
+{
+    int      i;
+    int      rc;
+    size_t   n;
+    wchar_t *cmdblk = NULL;
+    wchar_t *envblk = NULL;
+
+    /**
+     * Each argument can be response file,
+     * and one more for the spilled command line
+     */
+    rspfiles = xwaalloc(argc);
+    tracebegin();
+    tracer.argseen = argc - 1;
+    for (i = 1; i < argc; i++) {
+        wchar_t *v;
+        wchar_t *a = argv[i];
+
+        if (*a == L'\'') {
+            if (argv[0] != zerowcs)
+                continue;
+            n = xwcslen(a);
+            if (a[n - 1] == L'\'') {
+                v = xwalloc(n - 2);
+                wmemcpy(v, a + 1, n - 2);
+                xmfree(a);
+                argv[i] = v;
+            }
+            continue;
+        }
+        if ((a[0] == L'@') && (a[1] != 0) && (argv[0] != zerowcs)) {
+            v = rspfiletowin(a);
+            if (v != NULL) {
+                xmfree(a);
+                argv[i] = v;
+                tracer.argxlat++;
+                continue;
+            }
+        }
+        argv[i] = argtowin(a);
+        if (argv[i] != a)
+            tracer.argxlat++;
+    }
+    traceend(XTRACE_ARGS);
+    if (argv[0] == zerowcs) {
+        for (i = 1; i < argc; i++) {
+            char *u = xwcstombs(argv[i]);
+            if (i > 1)
+                fputc('\n', stdout);
+            fputs(u, stdout);
+            xmfree(u);
+        }
+        return 0;
+    }
+    tracebegin();
+    translateenv();
+    traceend(XTRACE_ENV);
+    tracebegin();
+    n = xcmdlinelen(argc, argv);
+    if (!xcmdlinefits(n) && configvals[CYGWRUN_RSPFILE]) {
+        wchar_t *a = spillrspfile(argc - 1, argv + 1);
+
+        if (a != NULL) {
+            argv[1] = a;
+            argc    = 2;
+            n       = xcmdlinelen(argc, argv);
+        }
+    }
+    cmdblk = xcmdline(argc, argv, n);
+    traceend(XTRACE_CMDLINE);
+    tracebegin();
+    envblk = getenvblock(xenvvars, xenvvals);
+    traceend(XTRACE_ENVBLOCK);
+    if (configvals[CYGWRUN_TRACE] && envblk) {
+        const wchar_t *e = envblk;
+
+        while (*e)
+            e += xwcslen(e) + 1;
+        tracer.envsize = (size_t)(e - envblk + 1) * sizeof(wchar_t);
+    }
+    rc = launchprogram(argv[0], cmdblk, envblk);
+    delrspfiles();
+    return rc;
+}
+
 static int version(void)
 {
 #if CYGWRUN_ISDEV_VERSION
@@ -1995,46 +1095,411 @@ static int version(void)
     return 0;
 }
 
+/**
+ * Translate paths read from stdin and write them to stdout.
+ * The mode is either '-' or 'p' for windows to posix translation.
+ * Binary mode keeps the '\n' separators intact.
+ */
+static int streamprogram(int mode, int sep)
+{
+    _setmode(_fileno(stdin),  _O_BINARY);
+    _setmode(_fileno(stdout), _O_BINARY);
+    if (mode == 'p')
+        return xstreamtoposix(stdin, stdout, sep);
+    else
+        return xstreamtowin(stdin, stdout, sep);
+}
+
+/**
+ * Translation server and client.
+ *
+ * The server keeps the mount table and translated
+ * environments, and returns the program, command line and
+ * environment block for each request received from the
+ * named pipe. The client launches the program itself.
+ */
+static int pipeio(void *c, void *p, size_t n, int w)
+{
+    char  *b = (char *)p;
+    DWORD  r;
+    BOOL   s;
+
+    while (n > 0) {
+        r = 0;
+        if (w)
+            s = WriteFile((HANDLE)c, b, (DWORD)n, &r, NULL);
+        else
+            s = ReadFile((HANDLE)c, b, (DWORD)n, &r, NULL);
+        if (!s || (r == 0))
+            return 1;
+        b += r;
+        n -= r;
+    }
+    return 0;
+}
+
+static int piperecv(void *c, void *p, size_t n)
+{
+    return pipeio(c, p, n, 0);
+}
+
+static int pipesend(void *c, const void *p, size_t n)
+{
+    return pipeio(c, (void *)p, n, 1);
+}
+
+/**
+ * Get the value of the server environment variable.
+ * Returns NULL if the variable is not set.
+ */
+static wchar_t *getenvvar(const wchar_t *name)
+{
+    DWORD    n;
+    wchar_t *v;
+
+    n = GetEnvironmentVariableW(name, NULL, 0);
+    if (n == 0)
+        return NULL;
+    v = xwalloc(n);
+    if (GetEnvironmentVariableW(name, v, n) >= n) {
+        xmfree(v);
+        return NULL;
+    }
+    return v;
+}
+
+/**
+ * Translate the client environment the same way
+ * as main and runprogram does for the local launch.
+ * All globals that the translation sets are restored,
+ * including the server PATH set by initpath.
+ */
+static wchar_t *srvenvblock(const char **envp)
+{
+    const char  *cv[CYGWRUN_CONFIG_MAX];
+    const char **sn = systemenvn;
+    int          sc = systemenvc;
+    int          xc = xenvcount;
+    wchar_t    **xv = xenvvars;
+    wchar_t    **xl = xenvvals;
+    wchar_t     *pp = posixpath;
+    xpatset     *ps = askipenv;
+    xpatset     *pd = adelenvv;
+    wchar_t     *sp;
+    wchar_t    **wenv;
+    wchar_t     *r = NULL;
+
+    sp = getenvvar(L"PATH");
+    memcpy(cv, configvals, sizeof(configvals));
+    memset(configvals, 0, sizeof(configvals));
+    if ((initenvironment(envp) == 0) &&
+        (configvals[CCYGWIN_TEMP] != NULL) &&
+        (configvals[CCYGWIN_TMP]  != NULL) &&
+        (initpath() == 0)) {
+        compilepatterns();
+        wenv = xmbsslab(systemenvn, systemenvc);
+        if (setupenvironment(wenv) == 0) {
+            translateenv();
+            r = getenvblock(xenvvars, xenvvals);
+        }
+    }
+    memcpy(configvals, cv, sizeof(configvals));
+    systemenvn = sn;
+    systemenvc = sc;
+    xenvcount  = xc;
+    xenvvars   = xv;
+    xenvvals   = xl;
+    posixpath  = pp;
+    askipenv   = ps;
+    adelenvv   = pd;
+    SetEnvironmentVariableW(L"PATH", sp);
+    xmfree(sp);
+    return r;
+}
+
+/**
+ * Find the program using the client current directory and PATH.
+ * If the client has no PATH, the program is searched without it.
+ * Server current directory and PATH are restored after the search,
+ * so the server does not keep the client directory open while idle.
+ * The launch cache is not used, because its entries
+ * do not survive the server memory reset.
+ */
+static wchar_t *srvfindexe(const wchar_t *name, const wchar_t *cwd, const wchar_t *envblk)
+{
+    DWORD          n;
+    const wchar_t *e;
+    const wchar_t *p = NULL;
+    wchar_t       *r = NULL;
+    wchar_t       *sd;
+    wchar_t       *sp;
+
+    for (e = envblk; *e; e += xwcslen(e) + 1) {
+        if (xwcsnicmp(e, L"PATH=", 5) == 0) {
+            p = e + 5;
+            break;
+        }
+    }
+    n  = GetCurrentDirectoryW(0, NULL);
+    sd = xwalloc(n);
+    if ((n == 0) || (GetCurrentDirectoryW(n, sd) >= n)) {
+        xmfree(sd);
+        return NULL;
+    }
+    sp = getenvvar(L"PATH");
+    SetEnvironmentVariableW(L"PATH", p);
+    if (SetCurrentDirectoryW(cwd)) {
+        r = getrealpathname(name, 0);
+        if (r == NULL) {
+            SetSearchPathMode(BASE_SEARCH_PATH_DISABLE_SAFE_SEARCHMODE);
+            r = xsearchexe(name);
+        }
+        SetCurrentDirectoryW(sd);
+    }
+    SetEnvironmentVariableW(L"PATH", sp);
+    xmfree(sp);
+    xmfree(sd);
+    return r;
+}
+
+static const xsrvops pipeops = {
+    piperecv,
+    pipesend,
+    srvenvblock,
+    srvfindexe
+};
+
+/**
+ * Pipe name is CYGWRUN_SERVER value.
+ * Names without leading \\ are created inside \\.\pipe\
+ */
+static wchar_t *srvpipename(void)
+{
+    wchar_t *n = xmbstowcs(configvals[CYGWRUN_SERVER]);
+
+    if ((n[0] == L'\\') && (n[1] == L'\\'))
+        return n;
+    return xwcsconcat(L"\\\\.\\pipe\\", n, 0);
+}
+
+/**
+ * Serve clients one at a time until killed,
+ * or until the pipe cannot accept clients.
+ * Other clients wait for the pipe instance.
+ *
+ * The server fails if the pipe already exists, and the
+ * single pipe instance is reused for each client, so no
+ * other process can take the pipe name while the server
+ * runs. Remote clients are rejected.
+ */
+static int serveprogram(void)
+{
+    int      rv = 0;
+    DWORD    rc;
+    HANDLE   h;
+    wchar_t *pn;
+
+    pn = srvpipename();
+    h  = CreateNamedPipeW(pn, PIPE_ACCESS_DUPLEX | FILE_FLAG_FIRST_PIPE_INSTANCE,
+                          PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT |
+                          PIPE_REJECT_REMOTE_CLIENTS, 1,
+                          CYGWRUN_SRV_BUFSIZE, CYGWRUN_SRV_BUFSIZE, 0, NULL);
+    xmfree(pn);
+    if (h == INVALID_HANDLE_VALUE)
+        return CYGWRUN_FAILED;
+    /**
+     * Client that closed the pipe before it was accepted
+     * is the only connect error that the server survives
+     */
+    while (rv == 0) {
+        rc = ConnectNamedPipe(h, NULL) ? ERROR_PIPE_CONNECTED : GetLastError();
+        if (rc == ERROR_PIPE_CONNECTED) {
+            xsrvloop(&pipeops, h);
+            FlushFileBuffers(h);
+        }
+        else if (rc != ERROR_NO_DATA) {
+            rv = CYGWRUN_FAILED;
+        }
+        DisconnectNamedPipe(h);
+    }
+    CloseHandle(h);
+    return rv;
+}
+
+/**
+ * Get the user SID of the process p.
+ * The b must be large enough for TOKEN_USER.
+ */
+static PSID getprocessuser(HANDLE p, DWORD *b, DWORD n)
+{
+    HANDLE t;
+    DWORD  r;
+    BOOL   s;
+
+    if (!OpenProcessToken(p, TOKEN_QUERY, &t))
+        return NULL;
+    s = GetTokenInformation(t, TokenUser, b, n, &r);
+    CloseHandle(t);
+    if (!s)
+        return NULL;
+    return ((TOKEN_USER *)b)->User.Sid;
+}
+
+/**
+ * Check that the pipe server runs as the current user,
+ * so that the program it returns can be launched.
+ */
+static int srvtrusted(HANDLE h)
+{
+    int    rv = 0;
+    ULONG  pid;
+    HANDLE p;
+    PSID   ss;
+    PSID   cs;
+    DWORD  sb[CYGWRUN_SRV_SIDSIZE];
+    DWORD  cb[CYGWRUN_SRV_SIDSIZE];
+
+    if (!GetNamedPipeServerProcessId(h, &pid))
+        return 0;
+    p = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+    if (p == NULL)
+        return 0;
+    ss = getprocessuser(p, sb, sizeof(sb));
+    cs = getprocessuser(GetCurrentProcess(), cb, sizeof(cb));
+    if ((ss != NULL) && (cs != NULL) && EqualSid(ss, cs))
+        rv = 1;
+    CloseHandle(p);
+    return rv;
+}
+
+/**
+ * Environment hash skips the variables
+ * that are never passed to the child process
+ */
+static unsigned long long srvenvhash(const char **envp)
+{
+    unsigned long long h = 0;
+    const char        *ep;
+    const xenvname    *xe;
+
+    for (; *envp; envp++) {
+        ep = *envp;
+        if ((ep[0] == '=') || (ep[0] == '!'))
+            continue;
+        if ((ep[0] == '_') && (ep[1] == '='))
+            continue;
+        xe = xenvlookup(ep, xstrchrn(ep, '='));
+        if ((xe != NULL) && (xe->type == XENV_UNSET))
+            continue;
+        h = xsrvhash(h, ep);
+    }
+    return h;
+}
+
+/**
+ * Get the program, command line and environment block
+ * from the server and launch the program.
+ * Returns zero and sets the exit code in rc if the program
+ * was launched, or error if it has to be launched locally.
+ */
+static int clientprogram(int argc, const char **argv, const char **envp, int *rc)
+{
+    int      i;
+    int      rv;
+    DWORD    n;
+    HANDLE   h;
+    wchar_t *pn;
+    wchar_t *cd;
+    xsrvreq  rq;
+    xsrvres  rs;
+
+    for (i = 1; i < argc; i++) {
+        if (argv[i][0] == '@')
+            return CYGWRUN_EINVAL;
+    }
+    pn = srvpipename();
+    h  = CreateFileW(pn, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+    if ((h == INVALID_HANDLE_VALUE) && (GetLastError() == ERROR_PIPE_BUSY) &&
+        WaitNamedPipeW(pn, CYGWRUN_SRV_TIMEOUT))
+        h = CreateFileW(pn, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+    xmfree(pn);
+    if (h == INVALID_HANDLE_VALUE)
+        return CYGWRUN_ENOENT;
+    if (!srvtrusted(h)) {
+        CloseHandle(h);
+        return CYGWRUN_EINVAL;
+    }
+    n  = GetCurrentDirectoryW(0, NULL);
+    cd = xwalloc(n);
+    GetCurrentDirectoryW(n, cd);
+    /**
+     * Pruned PATH depends on the existing directories,
+     * so its environment is translated for each request
+     */
+    rq.hash = configvals[CYGWRUN_PRUNE] ? 0 : srvenvhash(envp);
+    rq.cwd  = xwcstombs(cd);
+    rq.argc = argc;
+    rq.argv = argv;
+    rq.envp = envp;
+    rv = xsrvcall(&pipeops, h, &rq, &rs);
+    CloseHandle(h);
+    xmfree(cd);
+    if (rv)
+        return rv;
+    if (configvals[CYGWRUN_TRACE]) {
+        cd = wcsrchr(rs.exe, L'\\');
+        tracer.name = xwcstombs(cd ? cd + 1 : rs.exe);
+    }
+    *rc = launchprogram(rs.exe, rs.cmdline, rs.envblk);
+    return 0;
+}
+
+/**
+ * Stream modes are '-', '-0', '-p' and '-p0'
+ */
+#define IS_STREAM_END(_s)   (((_s)[0] == '\0') || (((_s)[0] == '0') && ((_s)[1] == '\0')))
+#define IS_STREAM_ARG(_s)   (((_s)[0] == '-') && (IS_STREAM_END((_s) + 1) || \
+                            (((_s)[1] == 'p') && IS_STREAM_END((_s) + 2))))
+#define IS_SERVER_ARG(_s)   (((_s)[0] == '-') && ((_s)[1] == 'S') && ((_s)[2] == '\0'))
+#define IS_LOCAL_ARG(_s)    (IS_STREAM_ARG(_s) || IS_SERVER_ARG(_s) || \
+                            (((_s)[0] == '.') && ((_s)[1] == '\0')))
 #define __NEXT_ARG()   --argc; ++argv; optarg = *argv
 int main(int argc, const char **argv, const char **envp)
 {
     int         i;
     int         rv;
     wchar_t   **dupargv;
+    wchar_t   **wcsargv;
+    const char **mbsargv;
     wchar_t    *wparam;
     wchar_t    *eparam;
-    char       *sparam;
     const char *optarg;
-#if CYGWRUN_HAVE_CMDOPTS
-    const char *scmdopt = NULL;
-    const char *ucmdopt = NULL;
-#endif
     SetErrorMode(SEM_FAILCRITICALERRORS | SEM_NOOPENFILEERRORBOX | SEM_NOGPFAULTERRORBOX);
     if (argc < 2)
         return CYGWRUN_ENOEXEC;
     __NEXT_ARG();
     if ((argc == 1) && (optarg[0] == '-') && (optarg[1] == 'v') && (optarg[2] == '\0'))
         return version();
-#if CYGWRUN_USE_HEAPAPI
-#if CYGWRUN_USE_PRIVATE_HEAP
-    memheap = HeapCreate(0, 0, 0);
-#else
-    memheap = GetProcessHeap();
-#endif
-    if (memheap == NULL)
-        return CYGWRUN_ENOMEM;
-#endif
-    posixroot = getcygwinroot();
-    if (posixroot == NULL)
-        return CYGWRUN_ENOSYS;
+    rv = xmeminit();
+    if (rv)
+        return rv;
+    tracer.tick[XTRACE_TOTAL] = gettick();
+    tracebegin();
     rv = initenvironment(envp);
     if (rv)
         return rv;
+    traceend(XTRACE_INITENV);
+    if (configvals[CYGWRUN_CACHE]) {
+        wparam = xmbstowcs(configvals[CYGWRUN_CACHE]);
+        if (iswinpath(wparam))
+            xlcinit(&winfsops, wcleanpath(wparam));
+        xmfree(wparam);
+    }
     if ((configvals[CCYGWIN_TEMP] == NULL) ||
         (configvals[CCYGWIN_TMP]  == NULL))
         return CYGWRUN_EBADPATH;
 #if CYGWRUN_HAVE_CMDOPTS
-    while (*optarg == '-') {
+    while ((*optarg == '-') && !IS_STREAM_ARG(optarg)) {
         int opt = *++optarg;
 
         if (!xisalpha(opt) || (*++optarg != '='))
@@ -2062,86 +1527,108 @@ int main(int argc, const char **argv, const char **envp)
 #endif
     if (argc < 1)
         return CYGWRUN_ENOEXEC;
-    sparam   = xstrdup(configvals[CYGWRUN_SKIP]);
-#if CYGWRUN_HAVE_CMDOPTS
-    sparam   = xstrappend(sparam, scmdopt,  ',');
-#endif
-    sparam   = xstrappend(sparam, sskipenv, ',');
-    wparam   = xmbstowcs(sparam);
-    askipenv = wcstoarray(wparam, L',');
-#if CYGWRUN_USE_MEMFREE
+    /**
+     * Server already knows the posix root, so it
+     * is found only when the server cannot be used
+     */
+    if (configvals[CYGWRUN_SERVER] && !IS_LOCAL_ARG(optarg)) {
+        if (clientprogram(argc, argv, envp, &rv) == 0) {
+            writetrace(rv);
+            xmemdone();
+            return rv;
+        }
+    }
+    tracebegin();
+    posixroot = getlaunchroot();
+    if (posixroot == NULL)
+        return CYGWRUN_ENOSYS;
+    traceend(XTRACE_ROOT);
+    tracebegin();
+    rv = initmounts(NULL);
+    if (rv)
+        return rv;
+    if (configvals[CYGWRUN_FSTAB])
+        wparam = pathtowin(xmbstowcs(configvals[CYGWRUN_FSTAB]));
+    else
+        wparam = xwcsconcat(posixroot, L"\\etc\\fstab", 0);
+    eparam = readtextfile(wparam);
+    if (eparam) {
+        rv = initmounts(eparam);
+        if (rv)
+            return rv;
+        xmfree(eparam);
+    }
     xmfree(wparam);
-    xmfree(sparam);
-#endif
-    sparam   = xstrdup(configvals[CYGWRUN_UNSET]);
-#if CYGWRUN_HAVE_CMDOPTS
-    sparam   = xstrappend(sparam, ucmdopt,  ',');
-#endif
-    adelenvv = strtoarray(sparam, ',');
-#if CYGWRUN_USE_MEMFREE
-    xmfree(sparam);
-#endif
-    eparam = xmbstowcs(configvals[CYGWRUN_PATH]);
-    if (eparam == NULL)
-        eparam = xmbstowcs(configvals[CCYGWIN_PATH]);
-    if (eparam == NULL)
-        return CYGWRUN_ENOENT;
-    posixpath = pathstowin(eparam);
-    if (posixpath== NULL)
-        return CYGWRUN_EBADPATH;
-#if CYGWRUN_USE_MEMFREE
-    xmfree(eparam);
-#endif
-    SetEnvironmentVariableW(L"PATH", posixpath);
-    rv = setupenvironment();
+    traceend(XTRACE_MOUNTS);
+    if (IS_SERVER_ARG(optarg)) {
+        if ((argc > 1) || (configvals[CYGWRUN_SERVER] == NULL))
+            return CYGWRUN_EINVAL;
+        return serveprogram();
+    }
+    if (IS_STREAM_ARG(optarg)) {
+        if (argc > 1)
+            return CYGWRUN_EINVAL;
+        if (optarg[1] == 'p')
+            rv = streamprogram('p', optarg[2] == '0' ? 0 : '\n');
+        else
+            rv = streamprogram('-', optarg[1] == '0' ? 0 : '\n');
+        writetrace(rv);
+        xmemdone();
+        return rv;
+    }
+    tracebegin();
+    compilepatterns();
+    rv = initpath();
+    if (rv)
+        return rv;
+    /**
+     * Convert environment and arguments at once
+     */
+    mbsargv = (const char **)xsaalloc(systemenvc + argc);
+    for (i = 0; i < systemenvc; i++)
+        mbsargv[i] = systemenvn[i];
+    for (i = 0; i < argc; i++)
+        mbsargv[systemenvc + i] = argv[i];
+    wcsargv = xmbsslab(mbsargv, systemenvc + argc);
+    xmfree(mbsargv);
+    rv = setupenvironment(wcsargv);
     if (rv)
         return rv;
-    dupargv = xwaalloc(argc + 1);
+    traceend(XTRACE_SETUPENV);
+    tracebegin();
+    wcsargv += systemenvc;
+    dupargv  = xwaalloc(argc + 1);
     if ((*optarg == '.') && (*(optarg + 1) == '\0')) {
         dupargv[0] = zerowcs;
         if (argc < 2)
             return CYGWRUN_ENOEXEC;
     }
     else {
-        wparam = pathtowin(xmbstowcs(optarg));
-        if (wparam == NULL)
+        wparam = pathtowin(wcsargv[0]);
+        if (IS_EMPTY_WCS(wparam))
             return CYGWRUN_ENOEXEC;
-        eparam = getrealpathname(wparam, 0);
-        if (eparam == NULL) {
-            SetSearchPathMode(BASE_SEARCH_PATH_DISABLE_SAFE_SEARCHMODE);
-            eparam = xsearchexe(wparam);
-        }
+        eparam = getlaunchexe(wparam);
         if (eparam == NULL)
             return CYGWRUN_ENOEXEC;
         xmfree(wparam);
         dupargv[0] = eparam;
+        if (configvals[CYGWRUN_TRACE]) {
+            wparam = wcsrchr(eparam, L'\\');
+            tracer.name = xwcstombs(wparam ? wparam + 1 : eparam);
+        }
     }
     for (i = 1; i < argc; i++)
-        dupargv[i] = xmbstowcs(argv[i]);
+        dupargv[i] = wcsargv[i];
+    xlcsave();
+    traceend(XTRACE_SEARCH);
     rv = runprogram(i, dupargv);
+    writetrace(rv);
 #if CYGWRUN_USE_MEMFREE && CYGWRUN_ISDEV_VERSION
     xafree(xenvvals);
     xafree(xenvvars);
     xafree(dupargv);
-    xafree(askipenv);
-    xafree(adelenvv);
     xmfree(posixroot);
-    if (xnalloc != xnmfree)
-        fprintf(stderr, "\nAllocated: %llu\n"
-                        "alloc    : %d\n"
-                        "free     : %d\n",
-                        xzalloc, xnalloc, xnmfree);
-#endif
-#if CYGWRUN_USE_HEAPAPI
-#if CYGWRUN_USE_MEMFREE && CYGWRUN_ISDEV_VERSION
-    if (xzalloc != xzmfree)
-        fprintf(stderr, "\nAllocated: %llu\n"
-                        "Free     : %llu\n",
-                        xzalloc, xzmfree);
-#endif
-#if CYGWRUN_USE_PRIVATE_HEAP
-    HeapDestroy(memheap);
-#endif
 #endif
+    xmemdone();
     return rv;
 }
@@ -0,0 +1,201 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Build time generator of the environment variable name table
+ *
+ * Usage: mkenvhash OUTPUT LIST [LIST ...]
+ *
+ * Reads the variable names from list files and finds the hash
+ * seed and table size for which no two names share the same slot,
+ * so that each name is classified with one hash and one compare.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cygwcore.h"
+
+#define MAX_NAMES       1024
+#define MAX_SEEDS       1000000
+
+typedef struct envname_t {
+    char   name[128];
+    char   symbol[128];
+    int    len;
+    int    type;
+    int    index;
+} envname;
+
+static envname names[MAX_NAMES];
+static int     nnames  = 0;
+static int     nconfig = 0;
+
+static int readlist(const char *fname)
+{
+    FILE *fp;
+    char  b[512];
+    int   ln = 0;
+
+    fp = fopen(fname, "r");
+    if (fp == NULL) {
+        fprintf(stderr, "mkenvhash: cannot open %s\n", fname);
+        return 1;
+    }
+    while (fgets(b, sizeof(b), fp) != NULL) {
+        char  n[128];
+        char  c[128];
+        char  s[128];
+        int   f;
+        int   i;
+
+        ln++;
+        if ((b[0] == '#') || (sscanf(b, "%127s", n) != 1))
+            continue;
+        f = sscanf(b, "%127s %127s %127s", n, c, s);
+        if (nnames >= MAX_NAMES) {
+            fprintf(stderr, "mkenvhash: too many names\n");
+            fclose(fp);
+            return 1;
+        }
+        for (i = 0; i < nnames; i++) {
+            if (xstricmp(names[i].name, n) == 0) {
+                fprintf(stderr, "%s:%d: duplicate name %s\n", fname, ln, n);
+                fclose(fp);
+                return 1;
+            }
+        }
+        if ((f == 2) && (strcmp(c, "unset") == 0)) {
+            names[nnames].type  = XENV_UNSET;
+            names[nnames].index = 0;
+            strcpy(names[nnames].symbol, "0");
+        }
+        else if ((f == 3) && (strcmp(c, "config") == 0)) {
+            names[nnames].type  = XENV_CONFIG;
+            names[nnames].index = nconfig++;
+            strcpy(names[nnames].symbol, s);
+        }
+        else {
+            fprintf(stderr, "%s:%d: invalid entry\n", fname, ln);
+            fclose(fp);
+            return 1;
+        }
+        strcpy(names[nnames].name, n);
+        names[nnames].len = (int)strlen(n);
+        nnames++;
+    }
+    fclose(fp);
+    return 0;
+}
+
+static int tryseed(unsigned int seed, unsigned int mask, int *slots)
+{
+    int i;
+
+    for (i = 0; i <= (int)mask; i++)
+        slots[i] = -1;
+    for (i = 0; i < nnames; i++) {
+        unsigned int h;
+
+        h = xenvhash(names[i].name, names[i].len, seed) & mask;
+        if (slots[h] >= 0)
+            return 0;
+        slots[h] = i;
+    }
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    int           i;
+    int          *slots;
+    unsigned int  seed = 0;
+    unsigned int  mask = 1;
+    FILE         *fp;
+
+    if (argc < 3) {
+        fprintf(stderr, "Usage: mkenvhash OUTPUT LIST [LIST ...]\n");
+        return 1;
+    }
+    for (i = 2; i < argc; i++) {
+        if (readlist(argv[i]))
+            return 1;
+    }
+    while ((int)mask < (nnames * 2))
+        mask = (mask << 1) | 1;
+    slots = (int *)malloc(sizeof(int) * MAX_NAMES * 16);
+    if (slots == NULL) {
+        fprintf(stderr, "mkenvhash: out of memory\n");
+        return 1;
+    }
+    for (;;) {
+        for (seed = 1; seed < MAX_SEEDS; seed++) {
+            if (tryseed(seed, mask, slots))
+                break;
+        }
+        if (seed < MAX_SEEDS)
+            break;
+        mask = (mask << 1) | 1;
+        if (mask >= MAX_NAMES * 16) {
+            fprintf(stderr, "mkenvhash: cannot find perfect hash\n");
+            free(slots);
+            return 1;
+        }
+    }
+
+    fp = fopen(argv[1], "w");
+    if (fp == NULL) {
+        fprintf(stderr, "mkenvhash: cannot create %s\n", argv[1]);
+        free(slots);
+        return 1;
+    }
+    fprintf(fp, "/**\n * Generated by mkenvhash. Do not edit.\n */\n\n");
+    fprintf(fp, "#ifndef _CYGWENV_H_INCLUDED_\n#define _CYGWENV_H_INCLUDED_\n\n");
+    fprintf(fp, "#define XENV_HASH_SEED          %uU\n", seed);
+    fprintf(fp, "#define XENV_HASH_MASK          %uU\n", mask);
+    fprintf(fp, "#define XENV_NAMES              %d\n\n", nnames);
+    fprintf(fp, "typedef enum {\n");
+    for (i = 0; i < nnames; i++) {
+        if (names[i].type == XENV_CONFIG)
+            fprintf(fp, "    %-24s = %d,\n", names[i].symbol, names[i].index);
+    }
+    fprintf(fp, "    CYGWRUN_CONFIG_MAX       = %d\n} CYGWRUN_CONFIG_VARS;\n\n", nconfig);
+    fprintf(fp, "static const xenvname xenvnames[] = {\n");
+    for (i = 0; i <= (int)mask; i++) {
+        if (slots[i] < 0) {
+            fprintf(fp, "    { NULL, 0, XENV_PASS, 0 },\n");
+        }
+        else {
+            envname *e = &names[slots[i]];
+
+            fprintf(fp, "    { \"%s\", %d, %s, %s },\n", e->name, e->len,
+                    e->type == XENV_CONFIG ? "XENV_CONFIG" : "XENV_UNSET",
+                    e->symbol);
+        }
+    }
+    fprintf(fp, "};\n\n");
+    fprintf(fp, "/**\n * Find the name of length n\n */\n");
+    fprintf(fp, "static __inline const xenvname *xenvlookup(const char *s, size_t n)\n{\n");
+    fprintf(fp, "    const xenvname *e;\n\n");
+    fprintf(fp, "    e = &xenvnames[xenvhash(s, n, XENV_HASH_SEED) & XENV_HASH_MASK];\n");
+    fprintf(fp, "    if ((e->len == (int)n) && (xstrnicmp(s, e->name, n) == 0))\n");
+    fprintf(fp, "        return e;\n");
+    fprintf(fp, "    return NULL;\n}\n\n");
+    fprintf(fp, "#endif /* _CYGWENV_H_INCLUDED_ */\n");
+    fclose(fp);
+    free(slots);
+    return 0;
+}
@@ -0,0 +1,883 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Native benchmark driver for cygwcore
+ *
+ * Usage: corebench [N] run each benchmark N rounds (default 100)
+ *
+ * Each benchmark runs over a generated corpus and the results
+ * are written to stdout as a single JSON document, with the
+ * time, number of allocations and allocated bytes per operation.
+ *
+ * Corpora:
+ *   vcvars64  environment of a Cygwin shell after running vcvars64.bat
+ *   path500   PATH with 500 entries
+ *   link20k   link command line with 20000 arguments
+ *   quoting   arguments with pathological quoting
+ *   scale64k  64K characters of input, processed 16 times
+ *   scale1m   1M characters of input, processed once
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "cygwcore.h"
+
+#define BENCH_ROUNDS    100
+#define BENCH_PATHLEN   500
+#define BENCH_LINKARGS  20000
+
+#if CYGWRUN_ISDEV_VERSION
+# define BENCH_NALLOC   xnalloc
+# define BENCH_ZALLOC   xzalloc
+#else
+# define BENCH_NALLOC   0
+# define BENCH_ZALLOC   0
+#endif
+
+typedef struct xbench_t {
+    double          ns;
+    long            na;
+    double          za;
+    struct timespec ts;
+    int             sa;
+    size_t          sz;
+} xbench;
+
+typedef struct xcorpus_t {
+    int             n;
+    wchar_t       **v;
+} xcorpus;
+
+static const wchar_t *volatile sink;
+static int rounds  = BENCH_ROUNDS;
+static int records = 0;
+
+static double nsdiff(struct timespec *s, struct timespec *e)
+{
+    return (double)(e->tv_sec - s->tv_sec) * 1e9 + (double)(e->tv_nsec - s->tv_nsec);
+}
+
+static void benchresume(xbench *b)
+{
+    b->sa = BENCH_NALLOC;
+    b->sz = BENCH_ZALLOC;
+    timespec_get(&b->ts, TIME_UTC);
+}
+
+static void benchpause(xbench *b)
+{
+    struct timespec te;
+
+    timespec_get(&te, TIME_UTC);
+    b->ns += nsdiff(&b->ts, &te);
+    b->na += BENCH_NALLOC - b->sa;
+    b->za += (double)(BENCH_ZALLOC - b->sz);
+}
+
+static void benchstart(xbench *b)
+{
+    b->ns = 0.0;
+    b->na = 0;
+    b->za = 0.0;
+    benchresume(b);
+}
+
+/**
+ * Write JSON result record for ops operations
+ */
+static void benchreport(xbench *b, const char *name, const char *corpus, long ops)
+{
+    if (ops < 1)
+        ops = 1;
+    printf("%s\n    { \"name\": \"%s\", \"corpus\": \"%s\", \"ops\": %ld, "
+           "\"ns_per_op\": %.1f, \"allocs_per_op\": %.2f, \"bytes_per_op\": %.1f }",
+           records++ ? "," : "", name, corpus, ops,
+           b->ns / ops, (double)b->na / ops, b->za / ops);
+}
+
+static void benchstop(xbench *b, const char *name, const char *corpus, long ops)
+{
+    benchpause(b);
+    benchreport(b, name, corpus, ops);
+}
+
+/**
+ * Number of rounds for corpus with n operations,
+ * so that large corpora do not exhaust the arena.
+ */
+static int benchrounds(int n)
+{
+    int r = (int)((long)rounds * 1000 / n);
+
+    if (r > rounds)
+        r = rounds;
+    return r < 1 ? 1 : r;
+}
+
+static wchar_t *wcsfmt(const wchar_t *fmt, int i)
+{
+    wchar_t b[CYGWRUN_PATH_MAX];
+
+    swprintf(b, CYGWRUN_PATH_MAX, fmt, i, i);
+    return xwcsdup(b);
+}
+
+static wchar_t *mbsdup(const char *s)
+{
+    size_t   i;
+    size_t   n = strlen(s);
+    wchar_t *d = xwalloc(n);
+
+    for (i = 0; i < n; i++)
+        d[i] = (unsigned char)s[i];
+    return d;
+}
+
+/**
+ * Join n formatted entries with separator c
+ */
+static wchar_t *wcsjoin(const wchar_t *const *fmt, int n, wchar_t c)
+{
+    int      i;
+    int      f = 0;
+    size_t   x = 0;
+    size_t   z = 0;
+    wchar_t *d;
+    wchar_t **e;
+
+    e = xwaalloc(n);
+    for (i = 0; i < n; i++) {
+        if (fmt[f] == NULL)
+            f = 0;
+        e[i] = wcsfmt(fmt[f++], i);
+        z += xwcslen(e[i]) + 1;
+    }
+    d = xwalloc(z);
+    for (i = 0; i < n; i++) {
+        if (i)
+            d[x++] = c;
+        z = xwcslen(e[i]);
+        wmemcpy(d + x, e[i], z);
+        x += z;
+    }
+    xafree((void **)e);
+    return d;
+}
+
+static const char *const vcvars[] = {
+    "ALLUSERSPROFILE",              "C:\\ProgramData",
+    "APPDATA",                      "C:\\Users\\build\\AppData\\Roaming",
+    "CommandPromptType",            "Native",
+    "CommonProgramFiles",           "C:\\Program Files\\Common Files",
+    "CommonProgramFiles(x86)",      "C:\\Program Files (x86)\\Common Files",
+    "CommonProgramW6432",           "C:\\Program Files\\Common Files",
+    "COMPUTERNAME",                 "BUILDHOST",
+    "ComSpec",                      "C:\\WINDOWS\\system32\\cmd.exe",
+    "CYGWIN",                       "winsymlinks:native",
+    "DevEnvDir",                    "C:\\Program Files\\Microsoft Visual Studio\\2022\\Enterprise\\Common7\\IDE\\",
+    "DriverData",                   "C:\\Windows\\System32\\Drivers\\DriverData",
+    "EXECIGNORE",                   "*.dll",
+    "ExtensionSdkDir",              "C:\\Program Files (x86)\\Microsoft SDKs\\Windows Kits\\10\\ExtensionSDKs",
+    "EXTERNAL_INCLUDE",             NULL,
+    "Framework40Version",           "v4.0",
+    "FrameworkDir",                 "C:\\Windows\\Microsoft.NET\\Framework64\\",
+    "FrameworkDir64",               "C:\\Windows\\Microsoft.NET\\Framework64\\",
+    "FrameworkVersion",             "v4.0.30319",
+    "FrameworkVersion64",           "v4.0.30319",
+    "FSHARPINSTALLDIR",             "C:\\Program Files\\Microsoft Visual Studio\\2022\\Enterprise\\Common7\\IDE\\CommonExtensions\\Microsoft\\FSharp\\Tools",
+    "HOME",                         "/home/build",
+    "HOMEDRIVE",                    "C:",
+    "HOMEPATH",                     "\\Users\\build",
+    "HOSTNAME",                     "buildhost",
+    "INCLUDE",                      NULL,
+    "INFOPATH",                     "/usr/local/info:/usr/share/info:/usr/info",
+    "LANG",                         "en_US.UTF-8",
+    "LIB",                          NULL,
+    "LIBPATH",                      NULL,
+    "LOCALAPPDATA",                 "C:\\Users\\build\\AppData\\Local",
+    "LOGONSERVER",                  "\\\\BUILDHOST",
+    "MANPATH",                      "/usr/local/man:/usr/share/man:/usr/man",
+    "NUMBER_OF_PROCESSORS",         "16",
+    "OLDPWD",                       "/home/build",
+    "OneDrive",                     "C:\\Users\\build\\OneDrive",
+    "OS",                           "Windows_NT",
+    "PATH",                         NULL,
+    "PATHEXT",                      ".COM;.EXE;.BAT;.CMD;.VBS;.VBE;.JS;.JSE;.WSF;.WSH;.MSC",
+    "Platform",                     "x64",
+    "PRINTER",                      "Microsoft Print to PDF",
+    "PROCESSOR_ARCHITECTURE",       "AMD64",
+    "PROCESSOR_IDENTIFIER",         "Intel64 Family 6 Model 154 Stepping 3, GenuineIntel",
+    "PROCESSOR_LEVEL",              "6",
+    "PROCESSOR_REVISION",           "9a03",
+    "ProgramData",                  "C:\\ProgramData",
+    "ProgramFiles",                 "C:\\Program Files",
+    "ProgramFiles(x86)",            "C:\\Program Files (x86)",
+    "ProgramW6432",                 "C:\\Program Files",
+    "PROMPT",                       "$P$G",
+    "PS1",                          "\\[\\e]0;\\w\\a\\]\\n\\[\\e[32m\\]\\u@\\h \\[\\e[33m\\]\\w\\[\\e[0m\\]\\n\\$ ",
+    "PSModulePath",                 "C:\\Program Files\\WindowsPowerShell\\Modules;C:\\WINDOWS\\system32\\WindowsPowerShell\\v1.0\\Modules",
+    "PUBLIC",                       "C:\\Users\\Public",
+    "PWD",                          "/home/build/src/project",
+    "SESSIONNAME",                  "Console",
+    "SHELL",                        "/bin/bash",
+    "SHLVL",                        "2",
+    "SYSTEMDRIVE",                  "C:",
+    "SYSTEMROOT",                   "C:\\WINDOWS",
+    "TEMP",                         "/tmp",
+    "TERM",                         "xterm-256color",
+    "TMP",                          "/tmp",
+    "TZ",                           "Europe/Zagreb",
+    "UCRTVersion",                  "10.0.22621.0",
+    "UniversalCRTSdkDir",           "C:\\Program Files (x86)\\Windows Kits\\10\\",
+    "USER",                         "build",
+    "USERDOMAIN",                   "BUILDHOST",
+    "USERNAME",                     "build",
+    "USERPROFILE",                  "C:\\Users\\build",
+    "VCIDEInstallDir",              "C:\\Program Files\\Microsoft Visual Studio\\2022\\Enterprise\\Common7\\IDE\\VC\\",
+    "VCINSTALLDIR",                 "C:\\Program Files\\Microsoft Visual Studio\\2022\\Enterprise\\VC\\",
+    "VCPKG_ROOT",                   "C:\\Program Files\\Microsoft Visual Studio\\2022\\Enterprise\\VC\\vcpkg",
+    "VCToolsInstallDir",            "C:\\Program Files\\Microsoft Visual Studio\\2022\\Enterprise\\VC\\Tools\\MSVC\\14.38.33130\\",
+    "VCToolsRedistDir",             "C:\\Program Files\\Microsoft Visual Studio\\2022\\Enterprise\\VC\\Redist\\MSVC\\14.38.33135\\",
+    "VCToolsVersion",               "14.38.33130",
+    "VisualStudioVersion",          "17.0",
+    "VS170COMNTOOLS",               "C:\\Program Files\\Microsoft Visual Studio\\2022\\Enterprise\\Common7\\Tools\\",
+    "VSCMD_ARG_app_plat",           "Desktop",
+    "VSCMD_ARG_HOST_ARCH",          "x64",
+    "VSCMD_ARG_TGT_ARCH",           "x64",
+    "VSCMD_VER",                    "17.8.3",
+    "VSINSTALLDIR",                 "C:\\Program Files\\Microsoft Visual Studio\\2022\\Enterprise\\",
+    "windir",                       "C:\\WINDOWS",
+    "WindowsLibPath",               "C:\\Program Files (x86)\\Windows Kits\\10\\UnionMetadata\\10.0.22621.0;C:\\Program Files (x86)\\Windows Kits\\10\\References\\10.0.22621.0",
+    "WindowsSdkBinPath",            "C:\\Program Files (x86)\\Windows Kits\\10\\bin\\",
+    "WindowsSdkDir",                "C:\\Program Files (x86)\\Windows Kits\\10\\",
+    "WindowsSDKLibVersion",         "10.0.22621.0\\",
+    "WindowsSdkVerBinPath",         "C:\\Program Files (x86)\\Windows Kits\\10\\bin\\10.0.22621.0\\",
+    "WindowsSDKVersion",            "10.0.22621.0\\",
+    "WindowsSDK_ExecutablePath_x64","C:\\Program Files (x86)\\Microsoft SDKs\\Windows\\v10.0A\\bin\\NETFX 4.8 Tools\\x64\\",
+    "WindowsSDK_ExecutablePath_x86","C:\\Program Files (x86)\\Microsoft SDKs\\Windows\\v10.0A\\bin\\NETFX 4.8 Tools\\",
+    "_",                            "/usr/bin/make",
+    "__DOTNET_ADD_64BIT",           "1",
+    "__DOTNET_PREFERRED_BITNESS",   "64",
+    "__VSCMD_PREINIT_PATH",         NULL,
+    NULL,                           NULL
+};
+
+static const wchar_t *const vcinclude[] = {
+    L"C:\\Program Files\\Microsoft Visual Studio\\2022\\Enterprise\\VC\\Tools\\MSVC\\14.38.33130\\include",
+    L"C:\\Program Files\\Microsoft Visual Studio\\2022\\Enterprise\\VC\\Tools\\MSVC\\14.38.33130\\ATLMFC\\include",
+    L"C:\\Program Files\\Microsoft Visual Studio\\2022\\Enterprise\\VC\\Auxiliary\\VS\\include",
+    L"C:\\Program Files (x86)\\Windows Kits\\10\\include\\10.0.22621.0\\ucrt",
+    L"C:\\Program Files (x86)\\Windows Kits\\10\\include\\10.0.22621.0\\um",
+    L"C:\\Program Files (x86)\\Windows Kits\\10\\include\\10.0.22621.0\\shared",
+    L"C:\\Program Files (x86)\\Windows Kits\\10\\include\\10.0.22621.0\\winrt",
+    L"C:\\Program Files (x86)\\Windows Kits\\10\\include\\10.0.22621.0\\cppwinrt",
+    L"C:\\Program Files (x86)\\Windows Kits\\NETFXSDK\\4.8\\include\\um",
+    NULL
+};
+
+static const wchar_t *const vclib[] = {
+    L"C:\\Program Files\\Microsoft Visual Studio\\2022\\Enterprise\\VC\\Tools\\MSVC\\14.38.33130\\ATLMFC\\lib\\x64",
+    L"C:\\Program Files\\Microsoft Visual Studio\\2022\\Enterprise\\VC\\Tools\\MSVC\\14.38.33130\\lib\\x64",
+    L"C:\\Program Files (x86)\\Windows Kits\\NETFXSDK\\4.8\\lib\\um\\x64",
+    L"C:\\Program Files (x86)\\Windows Kits\\10\\lib\\10.0.22621.0\\ucrt\\x64",
+    L"C:\\Program Files (x86)\\Windows Kits\\10\\lib\\10.0.22621.0\\um\\x64",
+    NULL
+};
+
+/**
+ * PATH inside Cygwin shell, so the Windows entries
+ * added by vcvars64 are in /cygdrive form.
+ */
+static const wchar_t *const vcpath[] = {
+    L"/cygdrive/c/Program Files/Microsoft Visual Studio/2022/Enterprise/VC/Tools/MSVC/14.38.33130/bin/HostX64/x64",
+    L"/cygdrive/c/Program Files/Microsoft Visual Studio/2022/Enterprise/Common7/IDE/VC/VCPackages",
+    L"/cygdrive/c/Program Files/Microsoft Visual Studio/2022/Enterprise/Common7/IDE/CommonExtensions/Microsoft/TestWindow",
+    L"/cygdrive/c/Program Files/Microsoft Visual Studio/2022/Enterprise/MSBuild/Current/bin/Roslyn",
+    L"/cygdrive/c/Program Files (x86)/Windows Kits/10/bin/10.0.22621.0/x64",
+    L"/cygdrive/c/Program Files (x86)/Windows Kits/10/bin/x64",
+    L"/cygdrive/c/Program Files/Microsoft Visual Studio/2022/Enterprise/MSBuild/Current/Bin/amd64",
+    L"/cygdrive/c/Windows/Microsoft.NET/Framework64/v4.0.30319",
+    L"/cygdrive/c/Program Files/Microsoft Visual Studio/2022/Enterprise/Common7/IDE",
+    L"/cygdrive/c/Program Files/Microsoft Visual Studio/2022/Enterprise/Common7/Tools",
+    L"/cygdrive/c/Program Files/Microsoft Visual Studio/2022/Enterprise/Common7/IDE/CommonExtensions/Microsoft/CMake/CMake/bin",
+    L"/cygdrive/c/Program Files/Microsoft Visual Studio/2022/Enterprise/Common7/IDE/CommonExtensions/Microsoft/CMake/Ninja",
+    L"/usr/local/bin",
+    L"/usr/bin",
+    L"/cygdrive/c/WINDOWS/system32",
+    L"/cygdrive/c/WINDOWS",
+    L"/cygdrive/c/WINDOWS/System32/Wbem",
+    L"/cygdrive/c/WINDOWS/System32/WindowsPowerShell/v1.0",
+    L"/cygdrive/c/WINDOWS/System32/OpenSSH",
+    L"/cygdrive/c/Program Files/Git/cmd",
+    L"/cygdrive/c/Program Files/dotnet",
+    L"/cygdrive/c/Users/build/AppData/Local/Microsoft/WindowsApps",
+    L"/cygdrive/c/Users/build/.dotnet/tools",
+    NULL
+};
+
+/**
+ * Entries of the 500 element PATH
+ */
+static const wchar_t *const longpath[] = {
+    L"/usr/local/lib/pkg%d/bin",
+    L"/usr/share/sdk-%d.0/bin",
+    L"/cygdrive/c/Tools/t%d/bin",
+    L"/home/build/.local/v%d/bin",
+    L"/cygdrive/d/x%d",
+    L"/usr/lib/jvm/jdk%d/bin",
+    NULL
+};
+
+/**
+ * Arguments of the link.exe command line with most
+ * object files inside a few shared directories.
+ */
+static const wchar_t *const linkargs[] = {
+    L"/home/build/src/project/out/obj/core/unit%d.obj",
+    L"/home/build/src/project/out/obj/core/gen/table%d.obj",
+    L"/home/build/src/project/out/obj/mod%d/unit%d.obj",
+    L"-LIBPATH:/home/build/src/project/out/lib%d",
+    L"/tmp/cc%dAbCdEf.o",
+    L"kernel32.lib",
+    L"/DEBUG:FULL",
+    L"-out:/home/build/src/project/out/bin/prog%d.exe",
+    L"/home/build/My Projects/src/obj%d/file%d.obj",
+    L"-PDB:/home/build/src/project/out/pdb/prog%d.pdb",
+    L"/cygdrive/c/Program Files (x86)/Windows Kits/10/lib/um/x64/uuid%d.lib",
+    NULL
+};
+
+static const wchar_t *const quoting[] = {
+    L"",
+    L" ",
+    L"\"",
+    L"\\",
+    L"a\\\\b",
+    L"C:\\Program Files\\",
+    L"C:\\Program Files\\\\\\\\",
+    L"\\\\server\\share with space\\\\",
+    L"say \"hello\" to \\\"all\\\"",
+    L"\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\"",
+    L"\"\"\"\"\"\"\"\"\"\"\"\"\"\"\"\"",
+    L"-DVALUE=\"a b\\\\\"",
+    L"tab\there\tand\tthere",
+    L"trailing\\\\\\\\\\\\\\\\\\\\\\\\ ",
+    L"\\\"\\\"\\\"\\\" \\\"\\\"\\\"\\\"",
+    L"-I\"C:\\Program Files (x86)\\Windows Kits\\10\\include\\\"",
+    NULL
+};
+
+static xcorpus vcnames;
+static xcorpus vcvalues;
+static xcorpus linkline;
+static xcorpus quotedargs;
+static wchar_t *path500;
+
+static void corpusinit(xcorpus *c, const wchar_t *const *fmt, int n)
+{
+    int i;
+    int f = 0;
+
+    c->n = n;
+    c->v = xwaalloc(n + 1);
+    for (i = 0; i < n; i++) {
+        if (fmt[f] == NULL)
+            f = 0;
+        c->v[i] = wcsfmt(fmt[f++], i);
+    }
+}
+
+static void makecorpora(void)
+{
+    int i;
+    int n;
+
+    for (n = 0; vcvars[n * 2]; n++)
+        ;
+    vcnames.n  = n;
+    vcnames.v  = xwaalloc(n);
+    vcvalues.n = n;
+    vcvalues.v = xwaalloc(n);
+    for (i = 0; i < n; i++) {
+        const char *k = vcvars[i * 2];
+        const char *v = vcvars[i * 2 + 1];
+
+        vcnames.v[i] = mbsdup(k);
+        if (v != NULL)
+            vcvalues.v[i] = mbsdup(v);
+        else if (strcmp(k, "INCLUDE") == 0 || strcmp(k, "EXTERNAL_INCLUDE") == 0)
+            vcvalues.v[i] = wcsjoin(vcinclude, 9, L';');
+        else if (strcmp(k, "LIB") == 0)
+            vcvalues.v[i] = wcsjoin(vclib, 5, L';');
+        else if (strcmp(k, "LIBPATH") == 0)
+            vcvalues.v[i] = wcsjoin(vclib, 3, L';');
+        else if (strcmp(k, "PATH") == 0)
+            vcvalues.v[i] = wcsjoin(vcpath, 23, L':');
+        else
+            vcvalues.v[i] = wcsjoin(vcpath + 12, 11, L':');
+    }
+    path500 = wcsjoin(longpath, BENCH_PATHLEN, L':');
+    corpusinit(&linkline, linkargs, BENCH_LINKARGS);
+    corpusinit(&quotedargs, quoting, 16);
+}
+
+static void benchenv(void)
+{
+    int      i;
+    int      r;
+    int      x;
+    int      m = 0;
+    xbench   b;
+    wchar_t *rv;
+    wchar_t **ev;
+    static const wchar_t *const patterns[] = {
+        L"*_HOME", L"CYGWIN_*", L"VSCMD_*", L"*PATH", L"Windows*Dir",
+        L"__*", L"PROCESSOR_*", L"*_?", NULL
+    };
+
+    r = benchrounds(vcvalues.n);
+    benchstart(&b);
+    for (x = 0; x < r; x++) {
+        for (i = 0; i < vcvalues.n; i++)
+            m += isanypath(1, vcvalues.v[i]) != 0;
+    }
+    benchstop(&b, "isanypath", "vcvars64", (long)r * vcvalues.n);
+
+    benchstart(&b);
+    for (x = 0; x < r; x++) {
+        for (i = 0; i < vcnames.n; i++) {
+            const wchar_t *const *p;
+
+            for (p = patterns; *p; p++)
+                m += xwcsimatch(vcnames.v[i], *p) == 0;
+        }
+    }
+    benchstop(&b, "xwcsimatch", "vcvars64", (long)r * vcnames.n * 8);
+
+    /**
+     * Translate the environment the same way runprogram
+     * does, and create the environment block.
+     */
+    ev = xwaalloc(vcvalues.n);
+    benchstart(&b);
+    for (x = 0; x < r; x++) {
+        for (i = 0; i < vcvalues.n; i++) {
+            ev[i] = anypathtowin(vcvalues.v[i]);
+            if (ev[i] == NULL)
+                ev[i] = vcvalues.v[i];
+            sink = ev[i];
+        }
+        benchpause(&b);
+        for (i = 0; i < vcvalues.n; i++) {
+            if (ev[i] != vcvalues.v[i])
+                xmfree(ev[i]);
+        }
+        benchresume(&b);
+    }
+    benchstop(&b, "pathstowin", "vcvars64", r);
+
+    benchstart(&b);
+    for (x = 0; x < r; x++) {
+        rv = getenvblock(vcnames.v, vcvalues.v);
+        sink = rv;
+        xmfree(rv);
+    }
+    benchstop(&b, "getenvblock", "vcvars64", r);
+    xmfree(ev);
+    if (m == 0)
+        fprintf(stderr, "\n");
+}
+
+static void benchpath(void)
+{
+    int      x;
+    int      r;
+    size_t   n;
+    xbench   b;
+    wchar_t *rv;
+    wchar_t *wp;
+    wchar_t *cp;
+    wchar_t **pe;
+    int      pn;
+
+    r = benchrounds(BENCH_PATHLEN);
+    /**
+     * Cold runs start each round with an empty
+     * path translation cache.
+     */
+    benchstart(&b);
+    for (x = 0; x < r; x++) {
+        benchpause(&b);
+        initmounts(NULL);
+        benchresume(&b);
+        rv = pathstowin(path500);
+        sink = rv;
+        xmfree(rv);
+    }
+    benchstop(&b, "pathstowin", "path500/cold", r);
+
+    benchstart(&b);
+    for (x = 0; x < r; x++) {
+        rv = pathstowin(path500);
+        sink = rv;
+        xmfree(rv);
+    }
+    benchstop(&b, "pathstowin", "path500", r);
+
+    wp = pathstowin(path500);
+    benchstart(&b);
+    for (x = 0; x < r; x++) {
+        rv = pathstoposix(wp);
+        sink = rv;
+        xmfree(rv);
+    }
+    benchstop(&b, "pathstoposix", "path500", r);
+
+    benchstart(&b);
+    for (x = 0; x < r; x++)
+        sink = (const wchar_t *)(size_t)isanypath(1, path500);
+    benchstop(&b, "isanypath", "path500", r);
+
+    /**
+     * Clean each translated element inside a scratch buffer
+     */
+    pe = wcstoarray(wp, L';');
+    n  = 0;
+    for (pn = 0; pe[pn]; pn++)
+        ;
+    for (x = 0; x < pn; x++) {
+        if (xwcslen(pe[x]) > n)
+            n = xwcslen(pe[x]);
+    }
+    cp = xwalloc(n);
+    benchstart(&b);
+    for (x = 0; x < r; x++) {
+        int i;
+
+        for (i = 0; i < pn; i++) {
+            wmemcpy(cp, pe[i], xwcslen(pe[i]) + 1);
+            sink = wcleanpath(cp);
+        }
+    }
+    benchstop(&b, "wcleanpath", "path500", (long)r * pn);
+    xmfree(cp);
+    xafree((void **)pe);
+    xmfree(wp);
+}
+
+static void benchargs(const xcorpus *c, const char *corpus)
+{
+    int      i;
+    int      x;
+    int      r;
+    int      m = 0;
+    size_t   n;
+    xbench   b;
+    wchar_t *rv;
+    wchar_t **wv;
+    FILE    *out;
+    char     cold[64];
+
+    r  = benchrounds(c->n);
+    wv = xwaalloc(c->n + 1);
+    benchstart(&b);
+    for (x = 0; x < r; x++) {
+        for (i = 0; i < c->n; i++)
+            m += isanypath(1, c->v[i]) != 0;
+    }
+    benchstop(&b, "isanypath", corpus, (long)r * c->n);
+
+    /**
+     * Cold runs start each round with empty
+     * path and directory caches.
+     */
+    sprintf(cold, "%.58s/cold", corpus);
+    benchstart(&b);
+    for (x = 0; x < r; x++) {
+        benchpause(&b);
+        initmounts(NULL);
+        benchresume(&b);
+        for (i = 0; i < c->n; i++) {
+            benchpause(&b);
+            rv = xwcsdup(c->v[i]);
+            benchresume(&b);
+            wv[i] = argtowin(rv);
+        }
+        benchpause(&b);
+        for (i = 0; i < c->n; i++)
+            xmfree(wv[i]);
+        benchresume(&b);
+    }
+    benchstop(&b, "argtowin", cold, (long)r * c->n);
+
+    benchstart(&b);
+    for (x = 0; x < r; x++) {
+        for (i = 0; i < c->n; i++) {
+            benchpause(&b);
+            rv = xwcsdup(c->v[i]);
+            benchresume(&b);
+            wv[i] = argtowin(rv);
+        }
+        if (x < r - 1) {
+            benchpause(&b);
+            for (i = 0; i < c->n; i++)
+                xmfree(wv[i]);
+            benchresume(&b);
+        }
+    }
+    benchstop(&b, "argtowin", corpus, (long)r * c->n);
+
+    benchstart(&b);
+    for (x = 0; x < r; x++) {
+        for (i = 0; i < c->n; i++) {
+            benchpause(&b);
+            rv = xwcsdup(wv[i]);
+            benchresume(&b);
+            rv = xquotearg(rv);
+            sink = rv;
+            benchpause(&b);
+            xmfree(rv);
+            benchresume(&b);
+        }
+    }
+    benchstop(&b, "xquotearg", corpus, (long)r * c->n);
+
+    benchstart(&b);
+    for (x = 0; x < r; x++) {
+        n  = xcmdlinelen(c->n, (const wchar_t **)wv);
+        rv = xcmdline(c->n, (const wchar_t **)wv, n);
+        sink = rv;
+        xmfree(rv);
+    }
+    benchstop(&b, "xcmdline", corpus, r);
+
+    out = tmpfile();
+    benchstart(&b);
+    for (x = 0; x < r; x++) {
+        rewind(out);
+        m += xargstorsp(out, c->n, (const wchar_t **)wv, 0);
+    }
+    benchstop(&b, "xargstorsp", corpus, r);
+    fclose(out);
+    for (i = 0; i < c->n; i++)
+        xmfree(wv[i]);
+    xmfree(wv);
+    if (m == 0)
+        fprintf(stderr, "\n");
+}
+
+static void benchstream(void)
+{
+    int      i;
+    int      n = BENCH_LINKARGS;
+    xbench   b;
+    FILE    *in;
+    FILE    *out;
+
+    in  = tmpfile();
+    out = tmpfile();
+    for (i = 0; i < n; i++)
+        fprintf(in, "/home/build/out/obj/d%d/x%d.obj\n", i % 64, i);
+    rewind(in);
+    benchstart(&b);
+    xstreamtowin(in, out, '\n');
+    benchstop(&b, "xstreamtowin", "lines20k", n);
+    fclose(in);
+    fclose(out);
+}
+
+/**
+ * Both scale corpora process the same number of characters,
+ * so the time per character must stay about the same.
+ */
+static void benchscale(size_t n, int r, const char *corpus)
+{
+    int      i;
+    size_t   x;
+    xbench   b;
+    wchar_t *pl;
+    wchar_t *rv;
+    char    *sb;
+    FILE    *in;
+    FILE    *out;
+
+    pl = xwalloc(n);
+    for (x = 0; x + 16 < n; x += 16)
+        swprintf(pl + x, 17, L"/usr/lib/d%05d:", (int)(x / 16) % 100000);
+    pl[x > 0 ? x - 1 : 0] = 0;
+    benchstart(&b);
+    for (i = 0; i < r; i++) {
+        rv = pathstowin(pl);
+        sink = rv;
+        xmfree(rv);
+    }
+    benchstop(&b, "pathstowin", corpus, (long)r * (long)n);
+    xmfree(pl);
+
+    in = tmpfile();
+    sb = xmalloc(n);
+    memset(sb, 'a', n);
+    sb[0] = '/';
+    fwrite(sb, 1, n, in);
+    xmfree(sb);
+    b.ns = 0.0;
+    b.na = 0;
+    b.za = 0.0;
+    for (i = 0; i < r; i++) {
+        rewind(in);
+        out = tmpfile();
+        benchresume(&b);
+        xstreamtowin(in, out, '\n');
+        benchpause(&b);
+        fclose(out);
+    }
+    benchreport(&b, "xstreamtowin", corpus, (long)r * (long)n);
+    fclose(in);
+}
+
+/**
+ * Scalar reference versions of the scanning kernels
+ */
+static size_t reflen(const wchar_t *s)
+{
+    const wchar_t *p = s;
+
+    while (*p)
+        p++;
+    return (size_t)(p - s);
+}
+
+static const wchar_t *refchr(const wchar_t *s, wchar_t c)
+{
+    while (*s) {
+        if (*s == c)
+            return s;
+        s++;
+    }
+    return NULL;
+}
+
+static int refquote(const wchar_t *s)
+{
+    while (*s) {
+        if (xisspace(*s) || (*s == 0x22))
+            return 1;
+        s++;
+    }
+    return 0;
+}
+
+static int refsep(const wchar_t *s)
+{
+    while (*s) {
+        if ((*s == L';') || (*s == L':') || IS_PSW(*s))
+            return *s;
+        s++;
+    }
+    return 0;
+}
+
+static void benchkernel(const char *name, int k, const wchar_t *s, size_t len, int n)
+{
+    int    i;
+    size_t x = 0;
+    char   cn[32];
+    char   kn[32];
+    xbench b;
+
+    sprintf(cn, "len%d", (int)len);
+    sprintf(kn, "%s/scalar", name);
+    benchstart(&b);
+    for (i = 0; i < n; i++) {
+        switch (k) {
+            case XSCAN_NUL:
+                x += reflen(s);
+            break;
+            case XSCAN_CHR:
+                x += refchr(s, L'|') == NULL;
+            break;
+            case XSCAN_SEP:
+                x += refsep(s);
+            break;
+            case XSCAN_QUOTE:
+                x += refquote(s);
+            break;
+        }
+        sink = s;
+    }
+    benchstop(&b, kn, cn, n);
+    benchstart(&b);
+    for (i = 0; i < n; i++) {
+        x += (size_t)(xwcsscan(s, k, L'|') - s);
+        sink = s;
+    }
+    benchstop(&b, name, cn, n);
+    if (x == 0)
+        fprintf(stderr, "\n");
+}
+
+static void benchkernels(void)
+{
+    size_t   i;
+    size_t   z;
+    wchar_t *s;
+    static const size_t sizes[] = { 16, 256, 4096, 16384, 0 };
+
+    for (z = 0; sizes[z]; z++) {
+        size_t len = sizes[z];
+        int    r   = (int)(rounds * 6400 / len) + 1;
+
+        s = xwalloc(len);
+        for (i = 0; i < len; i++)
+            s[i] = L'a' + (wchar_t)(i % 26);
+        benchkernel("xwcslen",     XSCAN_NUL,   s, len, r);
+        benchkernel("xwcschr",     XSCAN_CHR,   s, len, r);
+        benchkernel("separators",  XSCAN_SEP,   s, len, r);
+        benchkernel("xneedsquote", XSCAN_QUOTE, s, len, r);
+        xmfree(s);
+    }
+}
+
+int main(int argc, const char **argv)
+{
+    if (argc > 1)
+        rounds = atoi(argv[1]);
+    if (rounds < 1)
+        rounds = BENCH_ROUNDS;
+    if (xmeminit())
+        return 1;
+    posixroot = xwcsdup(L"C:\\cygwin64");
+    initmounts(NULL);
+    makecorpora();
+
+    printf("{\n  \"version\": \"%s\",\n  \"rounds\": %d,\n", CYGWRUN_VERSION_STR, rounds);
+    printf("  \"options\": { \"arena\": %d, \"pathcache\": %d, \"simd\": %d, \"allocstat\": %d },\n",
+           CYGWRUN_USE_ARENA, CYGWRUN_USE_PATHCACHE, CYGWRUN_USE_SIMD, CYGWRUN_ISDEV_VERSION);
+    printf("  \"results\": [");
+    benchenv();
+    benchpath();
+    benchargs(&linkline, "link20k");
+    benchargs(&quotedargs, "quoting");
+    benchstream();
+    benchscale(1 << 16, 16, "scale64k");
+    benchscale(1 << 20, 1,  "scale1m");
+    benchkernels();
+    printf("\n  ]\n}\n");
+    return 0;
+}
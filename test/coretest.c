@@ -0,0 +1,1226 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * The ASF licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Native unit test driver for cygwcore
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include "cygwcore.h"
+#include "cygwenv.h"
+
+static int failed = 0;
+static int passed = 0;
+
+static char *tombs(const wchar_t *s)
+{
+    static char b[4][1024];
+    static int  x = 0;
+    char *d = b[x++ & 3];
+    int   i;
+
+    if (s == NULL)
+        return strcpy(d, "(null)");
+    for (i = 0; s[i] && i < 1023; i++)
+        d[i] = s[i] < 0x80 ? (char)s[i] : '?';
+    d[i] = '\0';
+    return d;
+}
+
+static void check(const char *id, const wchar_t *rv, const wchar_t *ex)
+{
+    if ((rv == NULL) || (ex == NULL) ? rv != ex : wcscmp(rv, ex) != 0) {
+        fprintf(stderr, "Failed #%s: `%s' expected `%s'\n", id, tombs(rv), tombs(ex));
+        failed++;
+    }
+    else {
+        passed++;
+    }
+}
+
+static void checki(const char *id, int rv, int ex)
+{
+    if (rv != ex) {
+        fprintf(stderr, "Failed #%s: %d expected %d\n", id, rv, ex);
+        failed++;
+    }
+    else {
+        passed++;
+    }
+}
+
+static wchar_t *dupxlate(const wchar_t *s)
+{
+    return pathtowin(xwcsdup(s));
+}
+
+static void testpaths(void)
+{
+    check("1.1", dupxlate(L"/tmp"),                 L"C:\\cygwin64\\tmp");
+    check("1.2", dupxlate(L"/"),                    L"C:\\cygwin64");
+    check("1.3", dupxlate(L"/usr/bin/"),            L"C:\\cygwin64\\usr\\bin");
+    check("1.4", dupxlate(L"/cygdrive/d/foo//bar"), L"D:\\foo\\bar");
+    check("1.5", dupxlate(L"/opt/foo"),             L"/opt/foo");
+    check("1.6", dupxlate(L"/tmp/../foo"),          L"C:\\cygwin64\\tmp\\..\\foo");
+    check("1.7", dupxlate(L"c:/foo/./bar"),         L"C:\\foo\\bar");
+    check("1.8", dupxlate(L"//?/c:/foo"),           L"\\\\?\\C:\\foo");
+    check("1.9", dupxlate(L"/nologo"),              L"/nologo");
+
+    check("4.1", dupxlate(L"./tmp"),                L".\\tmp");
+    check("4.2", dupxlate(L"../tmp///foo"),         L"..\\tmp\\foo");
+    check("4.3", dupxlate(L".../tmp"),              L".../tmp");
+    check("4.5", dupxlate(L".."),                   L"..");
+    check("4.6", dupxlate(L"./tmp/.//foo/"),        L".\\tmp\\foo");
+}
+
+static void testlists(void)
+{
+    check("6.1", pathstowin(L"/tmp/a::/tmp/b:"),    L"C:\\cygwin64\\tmp\\a;C:\\cygwin64\\tmp\\b");
+    check("6.2", pathstowin(L"/tmp:/var: :../d"),   L"C:\\cygwin64\\tmp;C:\\cygwin64\\var;..\\d");
+    check("6.3", pathstowin(L"/usr:/sbin:/unknown:../dir"),
+                                                    L"/usr:/sbin:/unknown:../dir");
+    check("6.4", pathstowin(L"c:/a;/tmp/b;;x/y"),   L"C:\\a;C:\\cygwin64\\tmp\\b;x\\y");
+    check("6.5", pathstowin(L"/tmp/foo"),           L"C:\\cygwin64\\tmp\\foo");
+    check("6.6", pathstowin(L"./tmp:./bar"),        L".\\tmp;.\\bar");
+    check("6.7", pathstowin(L":::"),                L":::");
+    check("6.8", pathstowin(L"/:/cygdrive/d/x:/"),  L"C:\\cygwin64;D:\\x;C:\\cygwin64");
+    check("6.9", pathstowin(L"/usr/bin:/opt"),      L"/usr/bin:/opt");
+
+    checki("7.1", ispathlist(L"/tmp:/usr"),         L':');
+    checki("7.2", ispathlist(L"c:/tmp;/usr"),       L';');
+    checki("7.3", ispathlist(L"c:/tmp"),            0);
+    checki("7.4", isanypath(1, L"'/tmp"),           0);
+    checki("7.5", isposixpath(L"/cygdrive/c/x"),    100);
+    checki("7.6", isposixpath(L"/usr"),             207);
+}
+
+static int isdircalls = 0;
+
+static int isdirstub(const wchar_t *p)
+{
+    isdircalls++;
+    return wcsstr(p, L"dead") == NULL;
+}
+
+static void testprune(void)
+{
+    check("23.1", prunepath(L"C:\\a;c:\\A\\;C:\\b;;C:\\a", NULL),
+                                                    L"C:\\a;C:\\b");
+    check("23.2", prunepath(L"C:\\dead;C:\\x;c:\\DEAD\\;C:\\dead;C:\\", isdirstub),
+                                                    L"C:\\x;C:\\");
+    checki("23.3", isdircalls, 3);
+    check("23.4", prunepath(L"/usr/bin:/opt", isdirstub),
+                                                    L"/usr/bin:/opt");
+    check("23.5", prunepath(L".\\dead;x;X", isdirstub),
+                                                    L".\\dead;x");
+    checki("23.6", isdircalls, 3);
+    check("23.7", prunepath(pathstowin(L"/usr/bin:/tmp:/usr/bin/:/tmp/dead"), isdirstub),
+                                                    L"C:\\cygwin64\\usr\\bin;C:\\cygwin64\\tmp");
+    checki("23.8", isdircalls, 6);
+    check("23.9", prunepath(L"", NULL), NULL);
+}
+
+static void testviews(void)
+{
+    int            n = 0;
+    const wchar_t *s = L" a b ;;\t;c:\\x; ";
+    const wchar_t *c = s;
+    wchar_t      **sa;
+    xwcsview       t;
+
+    checki("25.1", xwcsnext(&c, L';', &t), 1);
+    checki("25.2", (int)t.n, 3);
+    checki("25.3", wcsncmp(t.s, L"a b", 3), 0);
+    checki("25.4", xwcsnext(&c, L';', &t), 1);
+    check("25.5", xwcsndup(t.s, t.n), L"c:\\x");
+    checki("25.6", xwcsnext(&c, L';', &t), 0);
+    checki("25.7", xwcsnext(&c, L';', &t), 0);
+    check("25.8", s, L" a b ;;\t;c:\\x; ");
+    sa = wcstoarray(L"::/usr/bin: :/tmp:", L':');
+    while (sa[n] != NULL)
+        n++;
+    checki("25.9", n, 2);
+    check("25.10", sa[0], L"/usr/bin");
+    check("25.11", sa[1], L"/tmp");
+    checki("25.12", wcstoarray(L" ; ", L';') == NULL, 1);
+    check("25.13", xwcsndup(L"abc", 0), NULL);
+}
+
+static void testlexer(void)
+{
+    int      i;
+    wchar_t  b[1024];
+    wchar_t *p;
+
+    checki("26.1", ispathlist(L"c:/a:/b"),          0);
+    checki("26.2", ispathlist(L"ab/c:/d"),          L':');
+    checki("26.3", ispathlist(L"/a:/b;c"),          L';');
+    checki("26.4", ispathlist(L":a"),               L':');
+    check("26.5",  anypathtowin(L"/tmp:/usr/bin"),  L"C:\\cygwin64\\tmp;C:\\cygwin64\\usr\\bin");
+    check("26.6",  anypathtowin(L"no path"),        NULL);
+    check("26.7",  anypathtowin(L"'/tmp"),          NULL);
+    check("26.8",  anypathtowin(L"./a"),            L".\\a");
+    /**
+     * List with more separators than the lexer
+     * keeps in its inline array
+     */
+    b[0] = 0;
+    for (i = 0; i < 40; i++)
+        wcscat(b, i & 1 ? L"/tmp:" : L" /usr/x:");
+    wcscat(b, L"/");
+    p = pathstowin(b);
+    checki("26.9", (int)xwcslen(p), 20 * 18 + 20 * 16 + 11);
+    check("26.10", p + 20 * 18 + 20 * 16,           L"C:\\cygwin64");
+    b[wcslen(b) - 1] = L'x';
+    check("26.11", pathstowin(b),                   b);
+    /**
+     * Elements classified by the lexer, and the ones
+     * spanning more segments or trimmed, that are not
+     */
+    check("26.12", pathstowin(L"/usr:/cygdrive/d/x:/"),
+                                                    L"C:\\cygwin64\\usr;D:\\x;C:\\cygwin64");
+    check("26.13", pathstowin(L"/usr:x;/tmp"),      L"\\usr:x;C:\\cygwin64\\tmp");
+    check("26.14", pathstowin(L"/usr ; /tmp/a"),    L"C:\\cygwin64\\usr;C:\\cygwin64\\tmp\\a");
+    check("26.15", anypathtowin(L"//srv/share"),    L"\\\\srv\\share");
+    check("26.16", anypathtowin(L"/usr"),           L"C:\\cygwin64\\usr");
+    check("26.17", anypathtowin(L"/nomount/x"),     NULL);
+}
+
+/**
+ * Cache counters stay at zero when the cache is disabled
+ */
+#define XPC_COUNT(_n)   (CYGWRUN_USE_PATHCACHE ? (_n) : 0)
+
+static void testcache(void)
+{
+    int h;
+    int m;
+
+    h = xpchits;
+    m = xpcmiss;
+    check("14.1", pathstowin(L"/usr/x1:/tmp/x2:/usr/x1"),
+                                                    L"C:\\cygwin64\\usr\\x1;C:\\cygwin64\\tmp\\x2;C:\\cygwin64\\usr\\x1");
+    checki("14.2", xpchits - h, XPC_COUNT(1));
+    checki("14.3", xpcmiss - m, XPC_COUNT(2));
+    check("14.4", pathstowin(L"/tmp/x2:/opt/x3"),   L"/tmp/x2:/opt/x3");
+    check("14.5", pathstowin(L"/opt/x3;/tmp/x2"),   L"\\opt\\x3;C:\\cygwin64\\tmp\\x2");
+    check("14.6", pathstowin(L"/opt/x3:/tmp/x2"),   L"/opt/x3:/tmp/x2");
+    checki("14.7", xpchits - h, XPC_COUNT(4));
+    h = xpdhits;
+    m = xpdmiss;
+    check("14.8", dupxlate(L"/home/b/obj/a.obj"),   L"C:\\cygwin64\\home\\b\\obj\\a.obj");
+    check("14.9", dupxlate(L"/home/b/obj/b.obj"),   L"C:\\cygwin64\\home\\b\\obj\\b.obj");
+    check("14.10", dupxlate(L"/home/b//obj/./c"),   L"C:\\cygwin64\\home\\b\\obj\\c");
+    check("14.11", dupxlate(L"/home/b/obj/ d"),     L"C:\\cygwin64\\home\\b\\obj\\ d");
+    check("14.12", dupxlate(L"/cygdrive/c/x/e"),    L"C:\\x\\e");
+    check("14.13", dupxlate(L"/cygdrive/c/x/f"),    L"C:\\x\\f");
+    checki("14.14", xpdhits - h, XPC_COUNT(2));
+    checki("14.15", xpdmiss - m, XPC_COUNT(3));
+}
+
+static void testmounts(void)
+{
+    initmounts(L"# comment\n"
+               L"none /mnt cygdrive binary,posix=0,user 0 0\r\n"
+               L"D:/opt /opt ntfs binary 0 0\n"
+               L"E:/My\\040Tools/ /opt/tools ntfs binary 0 0\n"
+               L"F:/usrbin /usr/bin ntfs binary\n"
+               L"G:/gx /opt//gx/ ntfs binary\n"
+               L"H:/bad /opt/./bad ntfs binary\n"
+               L"H:/bad /opt/bad/.. ntfs binary\n"
+               L"none /proc proc\n");
+    check("11.1", dupxlate(L"/opt/foo"),            L"D:\\opt\\foo");
+    check("11.2", dupxlate(L"/opt/tools/x"),        L"E:\\My Tools\\x");
+    check("11.3", dupxlate(L"/opt/toolsx"),         L"D:\\opt\\toolsx");
+    check("11.4", dupxlate(L"/usr/bin/sh"),         L"F:\\usrbin\\sh");
+    check("11.5", dupxlate(L"/usr/lib"),            L"C:\\cygwin64\\usr\\lib");
+    check("11.6", dupxlate(L"/mnt/d/x"),            L"D:\\x");
+    check("11.7", dupxlate(L"/cygdrive/d/x"),       L"/cygdrive/d/x");
+    check("11.8", pathstowin(L"/opt:/usr/bin"),     L"D:\\opt;F:\\usrbin");
+    check("11.12", dupxlate(L"/opt/x1"),            L"D:\\opt\\x1");
+    check("11.13", dupxlate(L"/opt/tools"),         L"E:\\My Tools");
+    check("11.14", dupxlate(L"/usr/x1"),            L"C:\\cygwin64\\usr\\x1");
+    check("11.15", dupxlate(L"/usr/bin"),           L"F:\\usrbin");
+    check("11.16", dupxlate(L"/opt/gx/y"),          L"G:\\gx\\y");
+    check("11.17", dupxlate(L"/opt/gx//y/./z"),     L"G:\\gx\\y\\z");
+    check("11.18", dupxlate(L"/opt/bad/y"),         L"D:\\opt\\bad\\y");
+    check("11.19", dupxlate(L"/opt"),               L"D:\\opt");
+    checki("11.9", isposixpath(L"/proc/self"),      0);
+    initmounts(L"none / cygdrive binary 0 0\n");
+    check("11.10", dupxlate(L"/d/x/"),              L"D:\\x");
+    check("11.11", dupxlate(L"/tmp/x"),             L"C:\\cygwin64\\tmp\\x");
+    initmounts(NULL);
+}
+
+static int streamtest(int (*xs)(FILE *, FILE *, int),
+                      const char *src, size_t n, int sep, char *dst, size_t *sz)
+{
+    int   rv;
+    FILE *in  = tmpfile();
+    FILE *out = tmpfile();
+
+    fwrite(src, 1, n, in);
+    rewind(in);
+    rv  = xs(in, out, sep);
+    rewind(out);
+    *sz = fread(dst, 1, 4096, out);
+    dst[*sz] = '\0';
+    fclose(in);
+    fclose(out);
+    return rv;
+}
+
+/**
+ * Run the stream function and return its whole output
+ */
+static char *streamall(int (*xs)(FILE *, FILE *, int),
+                       const char *src, size_t n, int sep, size_t *sz)
+{
+    long  z;
+    char *r;
+    FILE *in  = tmpfile();
+    FILE *out = tmpfile();
+
+    fwrite(src, 1, n, in);
+    rewind(in);
+    xs(in, out, sep);
+    z = ftell(out);
+    rewind(out);
+    r = xmalloc(z + 1);
+    *sz = fread(r, 1, z, out);
+    fclose(in);
+    fclose(out);
+    return r;
+}
+
+static wchar_t *dupposix(const wchar_t *s)
+{
+    return wintoposix(xwcsdup(s));
+}
+
+static void testposix(void)
+{
+    size_t sz;
+    char   b[4100];
+
+    check("17.1",  dupposix(L"C:\\cygwin64\\tmp\\x"),     L"/tmp/x");
+    check("17.2",  dupposix(L"C:\\cygwin64"),               L"/");
+    check("17.3",  dupposix(L"c:/cygwin64/home/u/"),        L"/home/u");
+    check("17.4",  dupposix(L"C:\\cygwin64x\\a"),          L"/cygdrive/c/cygwin64x/a");
+    check("17.5",  dupposix(L"D:\\foo\\\\bar\\"),          L"/cygdrive/d/foo/bar");
+    check("17.6",  dupposix(L"D:"),                         L"/cygdrive/d");
+    check("17.7",  dupposix(L"\\\\server\\share\\x"),       L"//server/share/x");
+    check("17.8",  dupposix(L"\\\\?\\C:\\x"),               L"/cygdrive/c/x");
+    check("17.9",  dupposix(L"\\\\?\\UNC\\srv\\sh"),        L"//srv/sh");
+    check("17.10", dupposix(L"foo\\bar"),                   L"foo\\bar");
+    check("17.11", pathstoposix(L"C:\\cygwin64\\bin; D:\\x"), L"/bin:/cygdrive/d/x");
+    check("17.12", pathstoposix(L"C:\\a;foo"),               L"C:\\a;foo");
+    checki("17.13", streamtest(xstreamtoposix, "C:\\cygwin64\\usr\nX=C:\\a;D:\\b\n", 28,
+                               '\n', b, &sz), 0);
+    checki("17.14", strcmp(b, "/usr\nX=/cygdrive/c/a:/cygdrive/d/b\n"), 0);
+    check("17.15", argtoposix(xwcsdup(L"--prefix=C:\\x")),    L"--prefix=/cygdrive/c/x");
+    check("17.16", argtoposix(xwcsdup(L"-DX=1")),             L"-DX=1");
+    initmounts(L"none /mnt cygdrive binary 0 0\n"
+               L"D:/opt /opt ntfs binary 0 0\n"
+               L"E:/My\\040Tools/ /opt/tools ntfs binary 0 0\n"
+               L"Z:/ /very/long/mount/point/name ntfs binary 0 0\n");
+    check("17.17", dupposix(L"E:\\My Tools\\x"),            L"/opt/tools/x");
+    check("17.18", dupposix(L"d:\\OPT\\foo"),               L"/opt/foo");
+    check("17.19", dupposix(L"G:\\x"),                      L"/mnt/g/x");
+    check("17.20", pathstoposix(L"Z:\\a;Z:\\b;Z:"),          L"/very/long/mount/point/name/a:"
+                                                          L"/very/long/mount/point/name/b:"
+                                                          L"/very/long/mount/point/name");
+    initmounts(L"none / cygdrive binary 0 0\n");
+    check("17.21", dupposix(L"G:\\x"),                      L"/g/x");
+    check("17.22", dupxlate(L"/g/x"),                       L"G:\\x");
+    initmounts(NULL);
+}
+
+static void testquote(void)
+{
+    check("8.1", xquotearg(xwcsdup(L"abc")),        L"abc");
+    check("8.2", xquotearg(xwcsdup(L"a b")),        L"\"a b\"");
+    check("8.3", xquotearg(xwcsdup(L"a\\\"b c")),   L"\"a\\\\\\\"b c\"");
+    check("8.4", xquotearg(xwcsdup(L"a b\\")),      L"\"a b\\\\\"");
+    check("8.5", xwcsquote(xwcsdup(L"C:\\a b\\x")), L"\"C:\\a b\\x\"");
+}
+
+static void testcmdline(void)
+{
+    int      i;
+    int      j;
+    int      x = 0;
+    size_t   n;
+    wchar_t *rv;
+    wchar_t *av[8];
+    static const wchar_t *ca[] = { L"C:\\Program Files\\x.exe", L"a b", L"a\\\\\"b",
+                                   L"c:\\x\\", L"c:\\x y\\", L"-D\"q\"" };
+    static const wchar_t cc[]  = L"a b\\\"\t";
+
+    n  = xcmdlinelen(6, ca);
+    rv = xcmdline(6, ca, n);
+    check("19.1", rv, L"\"C:\\Program Files\\x.exe\" \"a b\" \"a\\\\\\\\\\\"b\" "
+                      L"c:\\x\\ \"c:\\x y\\\\\" \"-D\\\"q\\\"\"");
+    checki("19.2", (int)n, (int)xwcslen(rv));
+
+    /**
+     * Compare with xquotearg and warraytomsz
+     */
+    srand(1);
+    for (i = 0; i < 2000; i++) {
+        for (j = 0; j < 8; j++) {
+            int k;
+            int z = rand() % 8;
+
+            av[j] = xwalloc(z);
+            for (k = 0; k < z; k++)
+                av[j][k] = cc[rand() % 6];
+            if (z == 0)
+                av[j][0] = L'x';
+        }
+        n  = xcmdlinelen(8, (const wchar_t **)av);
+        rv = xcmdline(8, (const wchar_t **)av, n);
+        av[0] = xwcsquote(av[0]);
+        for (j = 1; j < 8; j++)
+            av[j] = xquotearg(av[j]);
+        if ((n != xwcslen(rv)) || (wcscmp(rv, warraytomsz(8, (const wchar_t **)av, L' ')) != 0))
+            x++;
+    }
+    checki("19.3", x, 0);
+
+    /**
+     * Command line of exactly CYGWRUN_CMDLINE_MAX
+     * characters leaves no room for the zero
+     */
+    av[0] = L"cc";
+    av[1] = xwalloc(CYGWRUN_CMDLINE_MAX);
+    wmemset(av[1], L'a', CYGWRUN_CMDLINE_MAX - 3);
+    n = xcmdlinelen(2, (const wchar_t **)av);
+    checki("19.4", (int)n, CYGWRUN_CMDLINE_MAX);
+    checki("19.5", xcmdlinefits(n), 0);
+    av[1][CYGWRUN_CMDLINE_MAX - 4] = 0;
+    n = xcmdlinelen(2, (const wchar_t **)av);
+    checki("19.6", xcmdlinefits(n), 1);
+    checki("19.7", (int)xwcslen(xcmdline(2, (const wchar_t **)av, n)), CYGWRUN_CMDLINE_MAX - 1);
+}
+
+static void testmatch(void)
+{
+    checki("9.1", xwcsimatch(L"PROCESSOR_ARCH", L"PROCESSOR_@*"), 0);
+    checki("9.2", xwcsimatch(L"PROCESSOR_1",    L"PROCESSOR_@*") == 0, 0);
+    checki("9.3", xwcsimatch(L"path",           L"PATH"),         0);
+    checki("9.4", xstrimatch("FOOBAR",          "F*R"),           0);
+    checki("9.5", xstrimatch("FOOBAZ",          "F*R") == 0,      0);
+}
+
+static const wchar_t *skiplist[] = {
+    L"HOMEPATH",
+    L"PATH",
+    L"PROCESSOR_@*",
+    L"USER",
+    NULL
+};
+
+static void testpatset(void)
+{
+    wchar_t *s;
+    xpatset *ps;
+
+    ps = xpatcompile(skiplist, L" foo*bar , *_DIR,,X+Y ", L',');
+    checki("9.6",  xpatmatch(ps, L"path"),           1);
+    checki("9.7",  xpatmatch(ps, L"PROCESSOR_ARCH"), 2);
+    checki("9.8",  xpatmatch(ps, L"PROCESSOR_1"),    -1);
+    checki("9.9",  xpatmatch(ps, L"FOOBAR"),         4);
+    checki("9.10", xpatmatch(ps, L"FOO_x_BAR"),      4);
+    checki("9.11", xpatmatch(ps, L"FOOBARX"),        -1);
+    checki("9.12", xpatmatch(ps, L"TMP_DIR"),        5);
+    checki("9.13", xpatmatch(ps, L"X Y"),            -1);
+    checki("9.14", xpatmatch(ps, L"X=Y"),            6);
+    checki("9.15", xpatmatch(ps, L"PATHX"),          -1);
+    checki("9.16", xpatmatch(ps, L"1A_DIR"),         5);
+
+    /**
+     * Backtracking matcher would need exponential time here
+     */
+    ps = xpatcompile(NULL, L"*a*a*a*a*a*a*a*a*a*a*a*a*b,*a*1", L',');
+    s  = xwalloc(4096);
+    wmemset(s, L'a', 4096);
+    checki("9.17", xpatmatch(ps, s),                 -1);
+    s[4095] = L'B';
+    checki("9.18", xpatmatch(ps, s),                 0);
+    ps = xpatcompile(NULL, L"FOO,*", L',');
+    checki("9.19", xpatmatch(ps, L"BAR"),            1);
+}
+
+static void testenvnames(void)
+{
+    int i;
+    int n = 0;
+    const xenvname *e;
+
+    for (i = 0; i <= (int)XENV_HASH_MASK; i++) {
+        if (xenvnames[i].name == NULL)
+            continue;
+        if (xenvlookup(xenvnames[i].name, xenvnames[i].len) == &xenvnames[i])
+            n++;
+    }
+    checki("12.1", n, XENV_NAMES);
+    e = xenvlookup("path=/usr/bin", 4);
+    checki("12.2", e ? e->type  : -1, XENV_CONFIG);
+    checki("12.3", e ? e->index : -1, CCYGWIN_PATH);
+    e = xenvlookup("Tz", 2);
+    checki("12.4", e ? e->type  : -1, XENV_UNSET);
+    checki("12.5", xenvlookup("PATHEXT", 7) == NULL, 1);
+    checki("12.6", xenvlookup("PAT", 3)     == NULL, 1);
+    checki("12.7", xenvlookup("PS", 2)      == NULL, 1);
+}
+
+static void testutf8(void)
+{
+    wchar_t   b[16];
+    wchar_t **wa;
+    const char *sa[3];
+
+    checki("13.1", (int)xutf8towcs(b, "a\xc3\xa9\xe2\x82\xac"), 3);
+    checki("13.2", b[1], 0xE9);
+    checki("13.3", b[2], 0x20AC);
+#if WCHAR_MAX <= 0xFFFF
+    checki("13.4", (int)xutf8towcs(b, "\xf0\x9f\x98\x80"), 2);
+    checki("13.5", b[0], 0xD83D);
+#else
+    checki("13.4", (int)xutf8towcs(b, "\xf0\x9f\x98\x80"), 1);
+    checki("13.5", b[0], 0x1F600);
+#endif
+    checki("13.6", (int)xutf8towcs(b, "\xc0\xafx\xe2\x82"), 4);
+    checki("13.7", b[0] == 0xFFFD && b[1] == 0xFFFD && b[2] == L'x' && b[3] == 0xFFFD, 1);
+    checki("13.8", (int)xutf8towcs(NULL, "\xed\xa0\x80"), 1);
+
+    sa[0] = "FOO=bar";
+    sa[1] = "";
+    sa[2] = "x\xc3\xa9";
+    wa = xmbsslab(sa, 3);
+    check("13.9",  wa[0], L"FOO=bar");
+    check("13.10", wa[1], L"");
+    check("13.11", wa[2], L"x\x00e9");
+    checki("13.12", (int)(wa[2] - wa[0]), 9);
+    checki("13.13", wa[3] == NULL, 1);
+}
+
+/**
+ * In memory file system for launch cache tests
+ */
+static struct {
+    const wchar_t     *name;
+    unsigned long long mtime;
+    char              *data;
+} stubfiles[6] = {
+    { L"C:\\cygwin64\\bin\\cygwin1.dll", 100, NULL },
+    { L"C:\\bin\\cl.exe",                  200, NULL },
+    { L"C:\\launch.cache",                   0,   NULL },
+    { L"C:\\work",                           300, NULL },
+    { L"C:\\usr",                            400, NULL },
+    { NULL,                                  0,   NULL }
+};
+
+static int stubfind(const wchar_t *name)
+{
+    int i;
+
+    for (i = 0; stubfiles[i].name; i++) {
+        if (wcscmp(stubfiles[i].name, name) == 0)
+            return i;
+    }
+    return -1;
+}
+
+static int stubmtime(const wchar_t *name, unsigned long long *mt)
+{
+    int i = stubfind(name);
+
+    if ((i < 0) || (stubfiles[i].mtime == 0))
+        return 1;
+    *mt = stubfiles[i].mtime;
+    return 0;
+}
+
+static wchar_t *stubread(const wchar_t *name)
+{
+    int      i = stubfind(name);
+    wchar_t *r;
+
+    if ((i < 0) || (stubfiles[i].data == NULL))
+        return NULL;
+    r = xwalloc(xutf8towcs(NULL, stubfiles[i].data));
+    xutf8towcs(r, stubfiles[i].data);
+    return r;
+}
+
+static int stubwrite(const wchar_t *name, const char *data, size_t n)
+{
+    int i = stubfind(name);
+
+    if (i < 0)
+        return 1;
+    stubfiles[i].data = xmalloc(n);
+    memcpy(stubfiles[i].data, data, n);
+    stubfiles[i].mtime++;
+    return 0;
+}
+
+static const xfsops stubfs = { stubmtime, stubread, stubwrite };
+
+static void testlcache(void)
+{
+    char b[8];
+
+    checki("15.1", xlcinit(&stubfs, L"C:\\launch.cache"), 0);
+    check("15.2",  xlcget(L"root:C:\\bin"), NULL);
+    xlcput(L"root:C:\\bin", L"C:\\cygwin64", L"C:\\cygwin64\\bin\\cygwin1.dll");
+    xlcput(L"exe:C:\\bin|cl", L"C:\\bin\\cl.exe", L"C:\\bin\\cl.exe");
+    xlcput(L"exe:C:\\bin|x\ty", L"C:\\bin\\x.exe", L"C:\\bin\\cl.exe");
+    checki("15.3", xlcsave(), 0);
+    checki("15.4", strncmp(stubfiles[2].data, "0000000000000064\tC:\\cygwin64", 28), 0);
+
+    /**
+     * Reload and validate
+     */
+    checki("15.5", xlcinit(&stubfs, L"C:\\launch.cache"), 0);
+    check("15.6",  xlcget(L"root:C:\\bin"),        L"C:\\cygwin64");
+    check("15.7",  xlcget(L"exe:C:\\bin|cl"),      L"C:\\bin\\cl.exe");
+    check("15.8",  xlcget(L"exe:C:\\bin|x\ty"),   NULL);
+    stubfiles[1].mtime = 201;
+    check("15.9",  xlcget(L"exe:C:\\bin|cl"),      NULL);
+    check("15.10", xlcget(L"root:C:\\bin"),        L"C:\\cygwin64");
+    checki("15.11", xlcsave(), 0);
+    checki("15.12", xlcinit(&stubfs, L"C:\\launch.cache"), 0);
+    check("15.13", xlcget(L"exe:C:\\bin|cl"),      NULL);
+    check("15.14", xlcget(L"root:C:\\bin"),        L"C:\\cygwin64");
+
+    /**
+     * Round trip through UTF-8
+     */
+    checki("15.15", (int)xwcstoutf8(b, L"\x00e9\x20ac"), 5);
+    checki("15.16", memcmp(b, "\xc3\xa9\xe2\x82\xac", 6), 0);
+    checki("15.17", xlchits, 4);
+    checki("15.18", xlcmiss, 4);
+
+    /**
+     * Program found in PATH is validated by the current
+     * directory and PATH directories searched before it
+     */
+    stubfiles[1].mtime = 200;
+    xlcput(L"exe:C:\\work|cl", L"C:\\bin\\cl.exe", L"C:\\bin\\cl.exe;C:\\work;C:\\usr;C:\\none");
+    check("15.19", xlcget(L"exe:C:\\work|cl"),     L"C:\\bin\\cl.exe");
+    checki("15.20", xlcsave(), 0);
+    checki("15.21", xlcinit(&stubfs, L"C:\\launch.cache"), 0);
+    check("15.22", xlcget(L"exe:C:\\work|cl"),     L"C:\\bin\\cl.exe");
+    stubfiles[4].mtime = 401;
+    check("15.23", xlcget(L"exe:C:\\work|cl"),     NULL);
+    xlcput(L"exe:C:\\work|ls", L"C:\\bin\\ls.exe", L"C:\\bin\\ls.exe;C:\\work");
+    check("15.24", xlcget(L"exe:C:\\work|ls"),     NULL);
+}
+
+static void teststream(void)
+{
+    int    i;
+    int    n;
+    int    rv;
+    size_t sz;
+    char   b[4100];
+    char  *r;
+    char  *o;
+    FILE  *in;
+    FILE  *out;
+
+    rv = streamtest(xstreamtowin, "/tmp\n/usr/bin/\r\nFOO=/usr:/tmp\n\n/opt/x\nc:/x", 42, '\n', b, &sz);
+    checki("16.1", rv, 0);
+    checki("16.2", strcmp(b, "C:\\cygwin64\\tmp\n"
+                             "C:\\cygwin64\\usr\\bin\n"
+                             "FOO=C:\\cygwin64\\usr;C:\\cygwin64\\tmp\n"
+                             "\n"
+                             "/opt/x\n"
+                             "C:\\x"), 0);
+    rv = streamtest(xstreamtowin, "/tmp\0--a=\"/usr\"\0", 16, 0, b, &sz);
+    checki("16.3", rv, 0);
+    checki("16.4", (int)sz, 38);
+    checki("16.5", memcmp(b, "C:\\cygwin64\\tmp\0--a=\"C:\\cygwin64\\usr\"\0", 38), 0);
+    rv = streamtest(xstreamtowin, "/tmp/\xc3\xa9\n", 8, '\n', b, &sz);
+    checki("16.6", strcmp(b, "C:\\cygwin64\\tmp\\\xc3\xa9\n"), 0);
+
+    /**
+     * Record longer than the buffer
+     */
+    r = xmalloc(CYGWRUN_STREAM_BUFSIZ + 16);
+    memset(r, 'a', CYGWRUN_STREAM_BUFSIZ + 16);
+    checki("16.7", streamtest(xstreamtowin, r, CYGWRUN_STREAM_BUFSIZ + 16, '\n', b, &sz), 0);
+    o = streamall(xstreamtowin, r, CYGWRUN_STREAM_BUFSIZ + 16, '\n', &sz);
+    checki("16.11", (int)sz, CYGWRUN_STREAM_BUFSIZ + 16);
+    checki("16.12", memcmp(o, r, sz), 0);
+    xmfree(o);
+
+    /**
+     * Release memory during the stream
+     */
+    in  = tmpfile();
+    out = tmpfile();
+    for (i = 0, n = 0; n < (CYGWRUN_STREAM_RESET * 3); i++)
+        n += fprintf(in, "/usr/lib/pkg%d/x.o\n", i % 5000);
+    rewind(in);
+    checki("16.8", xstreamtowin(in, out, '\n'), 0);
+    rewind(out);
+    for (n = 0; fgets(b, sizeof(b), out) != NULL; n++) {
+        char x[64];
+
+        sprintf(x, "C:\\cygwin64\\usr\\lib\\pkg%d\\x.o\n", n % 5000);
+        if (strcmp(b, x) != 0)
+            break;
+    }
+    checki("16.9", n, i);
+    fclose(in);
+    fclose(out);
+    check("16.10", dupxlate(L"/usr/lib"), L"C:\\cygwin64\\usr\\lib");
+}
+
+static int rspstream(FILE *in, FILE *out, int sep)
+{
+    return xrsptowin(in, out);
+}
+
+static void testrspfile(void)
+{
+    int    i;
+    int    n;
+    size_t sz;
+    char   b[4100];
+    char  *r;
+    char  *o;
+    FILE  *in;
+    FILE  *out;
+    static const char rs[] = "/tmp/a.obj \"/usr/lib/x y.lib\"\r\n"
+                             "-LIBPATH:/usr/lib --out=/tmp/o.exe \"\" "
+                             "a\\\"b \"c\"\"d\" \\\\srv\\x\n\"/tmp/q\\\\\" z";
+    static const wchar_t *av[] = { L"a b", L"\U0001F600.c" };
+    static const char ws[] = "\xff\xfe\"\0/\0t\0m\0p\0/\0x\0 \0y\0";
+
+    checki("18.1", streamtest(rspstream, rs, sizeof(rs) - 1, 0, b, &sz), 0);
+    checki("18.2", strcmp(b, "C:\\cygwin64\\tmp\\a.obj\n"
+                             "\"C:\\cygwin64\\usr\\lib\\x y.lib\"\n"
+                             "-LIBPATH:/usr/lib\n"
+                             "--out=C:\\cygwin64\\tmp\\o.exe\n"
+                             "\"\"\n"
+                             "\"a\\\"b\"\n"
+                             "\"c\\\"d\"\n"
+                             "\\\\srv\\x\n"
+                             "C:\\cygwin64\\tmp\\q\n"
+                             "z\n"), 0);
+
+    /**
+     * UTF-16LE input with unterminated quote
+     */
+    checki("18.3", streamtest(rspstream, ws, sizeof(ws) - 1, 0, b, &sz), 0);
+    checki("18.4", (int)sz, 46);
+    checki("18.5", memcmp(b, "\xff\xfe\"\0C\0:\0\\\0c\0y\0g\0w\0i\0n\0""6\0""4\0\\\0t\0m\0p\0"
+                             "\\\0x\0 \0y\0\"\0\n\0", 46), 0);
+
+    /**
+     * Argument longer than the buffer
+     */
+    r = xmalloc(CYGWRUN_RSPARG_MAX + 16);
+    memset(r, 'a', CYGWRUN_RSPARG_MAX + 16);
+    checki("18.6", streamtest(rspstream, r, CYGWRUN_RSPARG_MAX + 16, 0, b, &sz), 0);
+    o = streamall(rspstream, r, CYGWRUN_RSPARG_MAX + 16, 0, &sz);
+    checki("18.15", (int)sz, CYGWRUN_RSPARG_MAX + 17);
+    checki("18.16", memcmp(o, r, CYGWRUN_RSPARG_MAX + 16), 0);
+    checki("18.17", o[CYGWRUN_RSPARG_MAX + 16], '\n');
+    xmfree(o);
+
+    /**
+     * Large link response file
+     */
+    in  = tmpfile();
+    out = tmpfile();
+    for (i = 0, n = 0; n < (CYGWRUN_STREAM_RESET * 2); i++)
+        n += fprintf(in, "\"/usr/lib/pkg%d/x \xc3\xa9.o\"%c", i % 5000, (i % 8) ? ' ' : '\n');
+    rewind(in);
+    checki("18.7", xrsptowin(in, out), 0);
+    rewind(out);
+    for (n = 0; fgets(b, sizeof(b), out) != NULL; n++) {
+        char x[64];
+
+        sprintf(x, "\"C:\\cygwin64\\usr\\lib\\pkg%d\\x \xc3\xa9.o\"\n", n % 5000);
+        if (strcmp(b, x) != 0)
+            break;
+    }
+    checki("18.8", n, i);
+    fclose(in);
+    fclose(out);
+
+    /**
+     * Spill quoted arguments
+     */
+    out = tmpfile();
+    checki("18.9",  xargstorsp(out, 2, av, 0), 0);
+    rewind(out);
+    sz = fread(b, 1, sizeof(b), out);
+    checki("18.10", (int)sz, 13);
+    checki("18.11", memcmp(b, "\"a b\"\n\xf0\x9f\x98\x80.c\n", 13), 0);
+    fclose(out);
+    out = tmpfile();
+    checki("18.12", xargstorsp(out, 2, av, 1), 0);
+    rewind(out);
+    sz = fread(b, 1, sizeof(b), out);
+    checki("18.13", (int)sz, 24);
+    checki("18.14", memcmp(b, "\xff\xfe\"\0a\0 \0b\0\"\0\n\0\x3d\xd8\x00\xde.\0c\0\n\0", 24), 0);
+    fclose(out);
+}
+
+static void testtrace(void)
+{
+    size_t n;
+    xtrace t;
+    char   b[CYGWRUN_TRACE_LINE];
+
+    memset(&t, 0, sizeof(xtrace));
+    t.freq = 10000000;
+    t.pid  = 42;
+    t.rc   = 3;
+    t.tick[XTRACE_ROOT]  = 12345;
+    t.tick[XTRACE_WAIT]  = 25000000005ULL;
+    t.tick[XTRACE_TOTAL] = 25000020000ULL;
+    t.envseen = 95;
+    t.envxlat = 12;
+    t.envskip = 4;
+    t.argseen = 7;
+    t.argxlat = 5;
+    t.envsize = 30120;
+    t.name    = "cl.exe";
+    n = xtraceline(b, &t);
+    checki("20.1", (int)n, (int)strlen(b));
+    checki("20.2", strncmp(b, "pid=42 rc=3 root=1234 initenv=0 ", 32), 0);
+    checki("20.3", strstr(b, " wait=2500000000 total=2500002000 ") != NULL, 1);
+    checki("20.4", strstr(b, " nvars=95 xvars=12 skipvars=4 nargs=7 xargs=5 envblk=30120 ") != NULL, 1);
+    checki("20.5", strcmp(b + n - 12, " exe=cl.exe\n"), 0);
+    checki("20.6", strchr(b, '\n') == b + n - 1, 1);
+    checki("20.9", strstr(b, " pcmiss=") < strstr(b, " pdhits="), 1);
+    checki("20.10", strstr(b, " pdmiss=") < strstr(b, " lchits="), 1);
+    t.name = NULL;
+    t.freq = 3;
+    t.tick[XTRACE_ROOT] = 1;
+    n = xtraceline(b, &t);
+    checki("20.7", strncmp(b, "pid=42 rc=3 root=333333 ", 24), 0);
+    checki("20.8", strstr(b, "exe=") == NULL, 1);
+}
+
+#if CYGWRUN_USE_MEMPROF
+static void testmemprof(void)
+{
+    FILE    *fp;
+    wchar_t *p;
+    char     b[256];
+    int      n = 0;
+
+    p = xwcsdup(L"abc");
+    xmfree(p);
+    p = xwcsconcat(L"abc", L"def", 0);
+    xmfree(p);
+    p = xwcsconcat(L"abc", L"def", 0);
+    fp = tmpfile();
+    xmemprof(fp);
+    rewind(fp);
+    while (fgets(b, sizeof(b), fp)) {
+        if (strncmp(b, "xwcsdup in testmemprof ", 23) == 0)
+            checki("21.1", atoi(b + 36), 1);
+        if (strncmp(b, "xwcsconcat in testmemprof ", 26) == 0)
+            checki("21.2", atoi(b + 36), 2);
+        if (strncmp(b, "Peak heap: ", 11) == 0)
+            n++;
+    }
+    checki("21.3", n, 1);
+    fclose(fp);
+    xmfree(p);
+}
+#endif
+
+/**
+ * Unix socket stand-in for the named pipe
+ */
+static int srvio(void *c, void *p, size_t n, int w)
+{
+    char   *b = (char *)p;
+    ssize_t r;
+
+    while (n > 0) {
+        r = w ? write(*(int *)c, b, n) : read(*(int *)c, b, n);
+        if (r <= 0)
+            return 1;
+        b += r;
+        n -= (size_t)r;
+    }
+    return 0;
+}
+
+static int srvrecv(void *c, void *p, size_t n)
+{
+    return srvio(c, p, n, 0);
+}
+
+static int srvsend(void *c, const void *p, size_t n)
+{
+    return srvio(c, (void *)p, n, 1);
+}
+
+static int srvenvcalls = 0;
+
+static wchar_t *srvenvblock(const char **envp)
+{
+    int       i;
+    int       n = 0;
+    wchar_t **vars;
+    wchar_t **vals;
+
+    srvenvcalls++;
+    while (envp[n])
+        n++;
+    vars = xmbsslab(envp, n);
+    vals = xwaalloc(n + 1);
+    for (i = 0; i < n; i++) {
+        wchar_t *v = wcschr(vars[i], L'=');
+
+        *(v++) = 0;
+        vals[i] = isanypath(1, v) ? pathstowin(v) : v;
+    }
+    return getenvblock(vars, vals);
+}
+
+static wchar_t *srvfindexe(const wchar_t *name, const wchar_t *cwd, const wchar_t *envblk)
+{
+    return xwcsconcat(name, L".exe", 0);
+}
+
+static const xsrvops srvops = {
+    srvrecv,
+    srvsend,
+    srvenvblock,
+    srvfindexe
+};
+
+static void testserver(void)
+{
+    int          fd[2];
+    int          st = -1;
+    int          i;
+    pid_t        pid;
+    xsrvreq      rq;
+    xsrvres      rs;
+    char        *la;
+    char        *lb;
+    unsigned int mh[9];
+    const char  *av[4] = { "/usr/bin/cc", "/tmp", "a b", NULL };
+    const char  *ev[3] = { "PATH=/usr/bin:/tmp", "FOO=bar", NULL };
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fd)) {
+        checki("22.0", -1, 0);
+        return;
+    }
+    pid = fork();
+    if (pid == 0) {
+        close(fd[0]);
+        i = xsrvloop(&srvops, &fd[1]);
+        /**
+         * Exit code tells the parent how many
+         * environments were translated
+         */
+        _exit(i ? 100 : srvenvcalls);
+    }
+    close(fd[1]);
+    rq.hash = xsrvhash(0, ev[0]);
+    rq.hash = xsrvhash(rq.hash, ev[1]);
+    rq.cwd  = "/tmp";
+    rq.argc = 3;
+    rq.argv = av;
+    rq.envp = ev;
+    checki("22.1", xsrvcall(&srvops, &fd[0], &rq, &rs), 0);
+    check("22.2", rs.exe, L"C:\\cygwin64\\usr\\bin\\cc.exe");
+    check("22.3", rs.cmdline, L"C:\\cygwin64\\usr\\bin\\cc.exe C:\\cygwin64\\tmp \"a b\"");
+    check("22.4", rs.envblk, L"FOO=bar");
+    check("22.5", rs.envblk + 8, L"PATH=C:\\cygwin64\\usr\\bin;C:\\cygwin64\\tmp");
+    /**
+     * Known hash does not send the environment
+     */
+    rq.envp = NULL;
+    av[0]   = "/cygdrive/c/bin/ls";
+    checki("22.6", xsrvcall(&srvops, &fd[0], &rq, &rs), 0);
+    check("22.7", rs.exe, L"C:\\bin\\ls.exe");
+    check("22.8", rs.envblk, L"FOO=bar");
+    rq.hash = xsrvhash(0, "FOO=baz");
+    checki("22.9", xsrvcall(&srvops, &fd[0], &rq, &rs), CYGWRUN_ENOENV);
+    checki("22.10", rs.exe == NULL, 1);
+    av[0]   = "";
+    rq.hash = xsrvhash(0, ev[0]);
+    rq.hash = xsrvhash(rq.hash, ev[1]);
+    checki("22.11", xsrvcall(&srvops, &fd[0], &rq, &rs), CYGWRUN_ENOEXEC);
+    /**
+     * Command line longer then CYGWRUN_CMDLINE_MAX
+     */
+    la = (char *)xmalloc(CYGWRUN_CMDLINE_MAX / 2 + 1);
+    memset(la, 'a', CYGWRUN_CMDLINE_MAX / 2);
+    av[0]   = "cc";
+    av[1]   = la;
+    av[2]   = la;
+    checki("22.12", xsrvcall(&srvops, &fd[0], &rq, &rs), CYGWRUN_ERANGE);
+    /**
+     * Command line of exactly CYGWRUN_CMDLINE_MAX characters
+     */
+    lb = (char *)xmalloc(CYGWRUN_CMDLINE_MAX);
+    memset(lb, 'a', CYGWRUN_CMDLINE_MAX - 7);
+    av[1]   = lb;
+    rq.argc = 2;
+    checki("22.21", xsrvcall(&srvops, &fd[0], &rq, &rs), CYGWRUN_ERANGE);
+    lb[CYGWRUN_CMDLINE_MAX - 8] = 0;
+    checki("22.22", xsrvcall(&srvops, &fd[0], &rq, &rs), 0);
+    checki("22.23", (int)xwcslen(rs.cmdline), CYGWRUN_CMDLINE_MAX - 1);
+    rq.argc = 3;
+    av[1]   = la;
+    xmfree(lb);
+    /**
+     * Enough requests to release the server memory.
+     * Translated environment must survive.
+     */
+    for (i = 0; i < 40; i++)
+        xsrvcall(&srvops, &fd[0], &rq, &rs);
+    xmfree(la);
+    av[1]   = "-c";
+    av[2]   = "x.c";
+    checki("22.13", xsrvcall(&srvops, &fd[0], &rq, &rs), 0);
+    check("22.14", rs.cmdline, L"cc.exe -c x.c");
+    /**
+     * Request with counts that overflow when added
+     * is rejected and the server keeps serving
+     */
+    memset(mh, 0, sizeof(mh));
+    mh[0] = CYGWRUN_SRV_MAGIC;
+    mh[2] = 24;
+    mh[5] = 0x80000000U;
+    mh[6] = 0x7FFFFFFFU;
+    srvsend(&fd[0], mh, 12 + 24);
+    checki("22.16", srvrecv(&fd[0], mh, 12), 0);
+    checki("22.17", (int)mh[1], CYGWRUN_EINVAL);
+    checki("22.18", (int)mh[2], 0);
+    checki("22.19", xsrvcall(&srvops, &fd[0], &rq, &rs), 0);
+    check("22.20", rs.cmdline, L"cc.exe -c x.c");
+    /**
+     * Zero hash environment is sent and translated
+     * with each request, and it is never cached
+     */
+    rq.hash = 0;
+    rq.envp = ev;
+    checki("22.24", xsrvcall(&srvops, &fd[0], &rq, &rs), 0);
+    check("22.25", rs.envblk, L"FOO=bar");
+    checki("22.26", xsrvcall(&srvops, &fd[0], &rq, &rs), 0);
+    rq.envp = NULL;
+    checki("22.27", xsrvcall(&srvops, &fd[0], &rq, &rs), CYGWRUN_ENOENV);
+    /**
+     * Invalid message is rejected
+     */
+    i = 0x12345678;
+    srvsend(&fd[0], &i, sizeof(i));
+    srvsend(&fd[0], &i, sizeof(i));
+    srvsend(&fd[0], &i, sizeof(i));
+    close(fd[0]);
+    waitpid(pid, &st, 0);
+    checki("22.15", WIFEXITED(st) ? WEXITSTATUS(st) : -1, 3);
+}
+
+static void testenvblock(void)
+{
+    int      i;
+    wchar_t *vars[4];
+    wchar_t *vals[4];
+    wchar_t *all[41];
+    wchar_t *alv[41];
+    wchar_t *eb;
+
+    vars[0] = xwcsdup(L"b");
+    vals[0] = xwcsdup(L"1");
+    vars[1] = xwcsdup(L"A");
+    vals[1] = xwcsdup(L"2");
+    vars[2] = xwcsdup(L"_X");
+    vals[2] = xwcsdup(L"3");
+    vars[3] = NULL;
+    vals[3] = NULL;
+    eb = getenvblock(vars, vals);
+    check("10.1", eb, L"A=2");
+    check("10.2", eb + 4, L"b=1");
+    check("10.3", eb + 8, L"_X=3");
+    checki("10.4", eb[13], 0);
+
+    /**
+     * Enough descents to use qsort
+     */
+    for (i = 0; i < 40; i++) {
+        vars[0] = xwalloc(8);
+        swprintf(vars[0], 8, L"V%02d", 39 - i);
+        all[i]  = vars[0];
+        alv[i]  = L"x";
+    }
+    all[i] = NULL;
+    alv[i] = NULL;
+    eb = getenvblock(all, alv);
+    check("10.5", eb, L"V00=x");
+    check("10.6", eb + 39 * 6, L"V39=x");
+    checki("10.7", eb[40 * 6], 0);
+}
+
+/**
+ * Build the inputs of n characters for the scale test.
+ * Element names start at b, so that rounds do not
+ * hit the path cache entries of previous rounds.
+ */
+static void scaleinput(size_t n, int b, wchar_t **pl, wchar_t **ha,
+                       wchar_t ***av, wchar_t ***vv, wchar_t ***ev, int *na)
+{
+    int    i;
+    int    c = (int)(n / 16);
+    size_t x = 0;
+
+    *pl = xwalloc(n + 32);
+    for (i = 0; x < n; i++)
+        x += swprintf(*pl + x, 32, L"%ls/usr/lib/p%07d", x ? L":" : L"", b + i);
+    *ha = xwalloc(n + 8);
+    wcscpy(*ha, L"-I/tmp/");
+    wmemset(*ha + 7, L'a', n);
+    *av = xwaalloc(c + 1);
+    for (i = 0; i < c; i++) {
+        (*av)[i] = xwalloc(16);
+        swprintf((*av)[i], 16, L"a b\\\"%07d", i);
+    }
+    *vv = xwaalloc(c / 4 + 1);
+    *ev = xwaalloc(c / 4 + 1);
+    for (i = 0; i < c / 4; i++) {
+        (*vv)[i] = xwalloc(16);
+        (*ev)[i] = xwalloc(64);
+        swprintf((*vv)[i], 16, L"V%07d", (c / 4 - i) * 7919 % 1000003);
+        wmemset((*ev)[i], L'v', 56);
+    }
+    *na = c;
+}
+
+static void scalerun(size_t n, int r, size_t *z)
+{
+    int       i;
+    int       na;
+    wchar_t  *pl;
+    wchar_t  *ha;
+    wchar_t **av;
+    wchar_t **vv;
+    wchar_t **ev;
+    FILE     *in;
+    FILE     *out;
+    char     *sb;
+
+    *z = 0;
+    in = tmpfile();
+    sb = xmalloc(n);
+    memset(sb, 'a', n);
+    sb[0] = '/';
+    fwrite(sb, 1, n, in);
+    xmfree(sb);
+    for (i = 0; i < r; i++) {
+        size_t  y;
+
+        scaleinput(n, i * (int)n, &pl, &ha, &av, &vv, &ev, &na);
+        rewind(in);
+        out = tmpfile();
+#if CYGWRUN_ISDEV_VERSION
+        y = xzalloc;
+#else
+        y = 0;
+#endif
+        xmfree(pathstowin(pl));
+        xmfree(argtowin(ha));
+        xmfree(xcmdline(na, (const wchar_t **)av, xcmdlinelen(na, (const wchar_t **)av)));
+        xmfree(getenvblock(vv, ev));
+        xstreamtowin(in, out, '\n');
+#if CYGWRUN_ISDEV_VERSION
+        *z += xzalloc - y;
+#endif
+        fclose(out);
+    }
+    fclose(in);
+}
+
+/**
+ * Memory must grow linearly with the input size.
+ * The small input is processed 16 times, so both runs
+ * handle the same amount of data.
+ * Timing is measured by corebench.
+ */
+static void testscale(void)
+{
+    size_t zs;
+    size_t zl;
+
+    scalerun(1 << 16, 16, &zs);
+    scalerun(1 << 20, 1,  &zl);
+#if CYGWRUN_ISDEV_VERSION
+    checki("24.2", zl < zs + zs / 4, 1);
+    checki("24.3", zl > zs - zs / 4, 1);
+#endif
+}
+
+int main(int argc, const char **argv)
+{
+    if (xmeminit())
+        return 1;
+    posixroot = xwcsdup(L"C:\\cygwin64");
+    initmounts(NULL);
+    testpaths();
+    testlists();
+    testprune();
+    testviews();
+    testlexer();
+    testcache();
+    testmounts();
+    testposix();
+    testquote();
+    testcmdline();
+    testmatch();
+    testpatset();
+    testenvnames();
+    testutf8();
+    testlcache();
+    teststream();
+    testrspfile();
+    testtrace();
+#if CYGWRUN_USE_MEMPROF
+    testmemprof();
+#endif
+    testenvblock();
+    testserver();
+    testscale();
+    xmemdone();
+    if (failed) {
+        fprintf(stderr, "%d of %d tests failed\n", failed, failed + passed);
+        return 1;
+    }
+    printf("All %d core tests passed!\n", passed);
+    return 0;
+}